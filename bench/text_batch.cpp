@@ -0,0 +1,99 @@
+// Times Font::paint_batch() against one Font::paint() per item: a table of
+// 200 x 12 cells painted into an 800x600 canvas, about a third of it off
+// screen. Built against libpepper:
+//
+//   text_batch <font.ttf> [pixel height]
+//
+// Without arguments only the builtin font is measured.
+
+#include <shaker/gfx/canvas.hpp>
+#include <shaker/gfx/font.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace
+{
+	enum { WIDTH = 800, HEIGHT = 600, ROWS = 200, COLUMNS = 12, REPEATS = 50 };
+
+	typedef std::chrono::steady_clock clock;
+
+	double milliseconds(clock::duration elapsed)
+	{
+		return std::chrono::duration<double, std::milli>(elapsed).count();
+	}
+
+	// average of REPEATS paints, after one to fill the caches
+	double single(const gfx::font::ptr& font, const std::vector<gfx::font::TextItem>& items, gfx::Canvas* canvas)
+	{
+		clock::time_point started;
+		for (int i = 0; i <= REPEATS; ++i)
+		{
+			if (i == 1)
+				started = clock::now();
+			for (auto&& item : items)
+				font->paint(*item.utf8, item.x, item.y, item.color, canvas);
+		}
+		return milliseconds(clock::now() - started) / REPEATS;
+	}
+
+	double batch(const gfx::font::ptr& font, const std::vector<gfx::font::TextItem>& items, gfx::Canvas* canvas)
+	{
+		clock::time_point started;
+		for (int i = 0; i <= REPEATS; ++i)
+		{
+			if (i == 1)
+				started = clock::now();
+			font->paint_batch(items.data(), items.size(), canvas);
+		}
+		return milliseconds(clock::now() - started) / REPEATS;
+	}
+
+	void measure(const char* name, const gfx::font::ptr& font)
+	{
+		std::vector<std::string> cells;
+		for (int row = 0; row < ROWS; ++row)
+		{
+			for (int column = 0; column < COLUMNS; ++column)
+				cells.push_back("Cell " + std::to_string(row * COLUMNS + column) + (column % 3 ? " ok" : " total"));
+		}
+
+		std::vector<gfx::font::TextItem> items;
+		long step = font->line_height() + 2;
+		for (int row = 0; row < ROWS; ++row)
+		{
+			for (int column = 0; column < COLUMNS; ++column)
+			{
+				gfx::font::TextItem item = { &cells[row * COLUMNS + column], column * 70 - 20, (int)(row * step - 200), 0x203040u + column * 0x100010u };
+				items.push_back(item);
+			}
+		}
+
+		std::vector<uint32_t> pixels(WIDTH * HEIGHT, 0xFFFFFFFF);
+		gfx::Canvas canvas(pixels.data(), WIDTH, HEIGHT);
+		double one_by_one = single(font, items, &canvas);
+		double batched = batch(font, items, &canvas);
+		printf("%-10s single %7.3f ms  batch %7.3f ms\n", name, one_by_one, batched);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	measure("builtin", gfx::font::builtin());
+
+	if (argc > 1)
+	{
+		int height = argc > 2 ? atoi(argv[2]) : 14;
+		auto font = gfx::font::truetype(argv[1], height);
+		if (!font)
+		{
+			fprintf(stderr, "%s: not a TrueType font\n", argv[1]);
+			return 1;
+		}
+		measure("truetype", font);
+	}
+
+	return 0;
+}
@@ -0,0 +1,32 @@
+#ifndef __GFX_ALPHA_MASK_HPP__
+#define __GFX_ALPHA_MASK_HPP__
+
+#include <stdint.h>
+
+namespace gfx
+{
+	class Canvas;
+
+	// 8-bit coverage, painted in a single color with Canvas::fill_mask
+	class AlphaMask
+	{
+		friend class Canvas;
+		const uint8_t* m_data;
+		int m_width, m_height, m_stride;
+	public:
+		AlphaMask(const uint8_t* data, int width, int height, int stride = 0)
+			: m_data(data)
+			, m_width(width)
+			, m_height(height)
+			, m_stride(stride ? stride : width)
+		{
+		}
+
+		const uint8_t* data() const { return m_data; }
+		int width() const { return m_width; }
+		int height() const { return m_height; }
+		int stride() const { return m_stride; }
+	};
+}
+
+#endif // __GFX_ALPHA_MASK_HPP__
@@ -2,6 +2,7 @@
 #define __GFX_BASIC_HPP__
 
 #include <ppapi/cpp/image_data.h>
+#include <shaker/gfx/yuv.hpp>
 #include <stdint.h>
 
 typedef uint32_t size_t;
@@ -44,13 +45,17 @@ namespace gfx
 		return clamp(((int)over * alpha + under * (255 - alpha)) / 255);
 	}
 
-	struct PlanarYUV420
+	// C is one of yuv::Coefficients<Matrix, Range>
+	template <typename C>
+	struct BasicPlanarYUV420
 	{
 		size_t halfWidth, halfHeight;
-		size_t Yplane;
-		size_t UVplane;
-		const uint8_t* in;
+		const uint8_t* Y;
+		const uint8_t* U;
+		const uint8_t* V;
+		size_t Ystride, Ustride, Vstride;
 		uint32_t* out;
+		size_t outStride;
 
 		struct Pixel4
 		{
@@ -107,10 +112,10 @@ namespace gfx
 				int u = *U - 128;
 				int v = *V - 128;
 
-				int y00 = Y0[0] - 16;
-				int y01 = Y0[1] - 16;
-				int y10 = Y1[0] - 16;
-				int y11 = Y1[1] - 16;
+				int y00 = Y0[0] - C::Y_OFFSET;
+				int y01 = Y0[1] - C::Y_OFFSET;
+				int y10 = Y1[0] - C::Y_OFFSET;
+				int y11 = Y1[1] - C::Y_OFFSET;
 
 				RGB0[0] = YUV(y00, u, v);
 				RGB0[1] = YUV(y01, u, v);
@@ -121,11 +126,11 @@ namespace gfx
 		private:
 			static inline uint32_t YUV(int y, int u, int v)
 			{
-				y *= 298;
+				y *= C::Y_MUL;
 				return RGB24(
-					/* R */ clamp((y + 409 * v + 128) >> 8),
-					/* G */ clamp((y - 100 * u - 208 * v + 128) >> 8),
-					/* B */ clamp((y + 516 * u + 128) >> 8)
+					/* R */ clamp((y + C::V_TO_R * v + 128) >> 8),
+					/* G */ clamp((y - C::U_TO_G * u - C::V_TO_G * v + 128) >> 8),
+					/* B */ clamp((y + C::U_TO_B * u + 128) >> 8)
 					);
 			}
 		};
@@ -142,9 +147,9 @@ namespace gfx
 
 		struct RowIterator
 		{
-			PlanarYUV420* parent;
+			BasicPlanarYUV420* parent;
 			size_t row;
-			RowIterator(PlanarYUV420* parent, size_t row) : parent(parent), row(row) {}
+			RowIterator(BasicPlanarYUV420* parent, size_t row) : parent(parent), row(row) {}
 			RowIterator(const RowIterator&) = default;
 			RowIterator& operator=(const RowIterator&) = default;
 
@@ -158,13 +163,38 @@ namespace gfx
 			}
 		};
 
-		PlanarYUV420(int w, int h, const void* in, uint32_t* out)
+		// Tightly packed I420 buffer, output stride equal to the width.
+		// The iterators only visit whole 2x2 clusters, so the last column and
+		// row of odd-sized frames are left alone; yuv::convert covers them.
+		BasicPlanarYUV420(int w, int h, const void* in, uint32_t* out)
 			: halfWidth(w >> 1)
 			, halfHeight(h >> 1)
-			, Yplane(w * h)
-			, UVplane((w >> 1) * (h >> 1))
-			, in((const uint8_t*)in)
+			, Y((const uint8_t*)in)
+			, U(Y + w * h)
+			, V(U + ((w + 1) >> 1) * ((h + 1) >> 1))
+			, Ystride(w)
+			, Ustride((w + 1) >> 1)
+			, Vstride((w + 1) >> 1)
 			, out(out)
+			, outStride(w)
+		{}
+
+		// separate planes with their own strides (in bytes); outStride is in pixels, 0 means the width
+		BasicPlanarYUV420(int w, int h,
+			const uint8_t* Y, size_t Ystride,
+			const uint8_t* U, size_t Ustride,
+			const uint8_t* V, size_t Vstride,
+			uint32_t* out, size_t outStride = 0)
+			: halfWidth(w >> 1)
+			, halfHeight(h >> 1)
+			, Y(Y)
+			, U(U)
+			, V(V)
+			, Ystride(Ystride)
+			, Ustride(Ustride)
+			, Vstride(Vstride)
+			, out(out)
+			, outStride(outStride ? outStride : w)
 		{}
 
 		RowIterator begin() { return RowIterator(this, 0); }
@@ -173,22 +203,20 @@ namespace gfx
 		// returns Pixel4 - a 4-pixel YUV420 cluster with output attached
 		Pixel4 row4(size_t half_y)
 		{
-			auto Y = in;
-			auto U = Y + Yplane;
-			auto V = U + UVplane;
-			auto Ystride = halfWidth << 1;
 			auto row = half_y << 1;
 			return{
 				Y + (row * Ystride),
 				Y + ((row + 1) * Ystride),
-				U + half_y * halfWidth,
-				V + half_y * halfWidth,
-				out + (row * Ystride),
-				out + ((row + 1) * Ystride)
+				U + half_y * Ustride,
+				V + half_y * Vstride,
+				out + (row * outStride),
+				out + ((row + 1) * outStride)
 			};
 		}
 	};
 
+	typedef BasicPlanarYUV420<yuv::Coefficients<yuv::BT601, yuv::Limited> > PlanarYUV420;
+
 	struct buffer
 	{
 		uint32_t * data;
@@ -20,8 +20,10 @@ namespace gfx
 		{
 		}
 
+		const uint32_t* data() const { return m_data; }
 		int width() const { return m_width; }
 		int height() const { return m_height; }
+		int stride() const { return m_stride; }
 	};
 }
 
@@ -8,6 +8,7 @@ namespace gfx
 	class Bitmap;
 	class AlphaBitmap;
 	class PaletteBitmap;
+	class AlphaMask;
 
 	class Canvas
 	{
@@ -21,16 +22,26 @@ namespace gfx
 	public:
 		Canvas(uint32_t* data, int width, int height, int stride = 0);
 
-		//uint32_t* data() { return m_data; }
+		uint32_t* data() { return m_data; }
+		const uint32_t* data() const { return m_data; }
 		int width() const { return m_width; }
 		int height() const { return m_height; }
-		//int stride() const { return m_stride; }
+		int stride() const { return m_stride; }
 
 		void rect(uint32_t color, int x, int y, int w, int h);
 		void put_pixel(int x, int y, uint32_t color);
 		void paint(int x, int y, const Bitmap& bmp);
 		void paint(int x, int y, const AlphaBitmap& bmp);
 		void paint(int x, int y, const PaletteBitmap& bmp);
+
+		// blends a 0xAARRGGBB color into the canvas, with the color's alpha scaled by the mask's coverage
+		void fill_mask(int x, int y, const AlphaMask& mask, uint32_t color);
+
+		// The same through a distance field drawn scale times its size with
+		// its top-left corner at (x, y). The field is 128 on the outline and
+		// changes by 127 over spread field pixels, rising inside; the edge is
+		// smoothed over one canvas pixel.
+		void fill_field(float x, float y, float scale, const AlphaMask& field, float spread, uint32_t color);
 	};
 }
 
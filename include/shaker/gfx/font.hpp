@@ -12,6 +12,33 @@ namespace gfx
 {
 	namespace font
 	{
+		// counters reported by the font caches
+		struct CacheStats
+		{
+			uint64_t hits;
+			uint64_t misses;
+			uint64_t evictions;
+			size_t entries;
+			size_t bytes;
+			size_t limit;  // in bytes
+		};
+
+		// time spent turning outlines into glyph bitmaps, to compare backends
+		struct RasterStats
+		{
+			uint64_t glyphs;
+			uint64_t pixels;
+			uint64_t microseconds;
+		};
+
+		// one string of a paint_batch(), which has to stay alive during the call
+		struct TextItem
+		{
+			const std::string* utf8;
+			int x, y;
+			uint32_t color;
+		};
+
 		struct Font
 		{
 			virtual ~Font() {}
@@ -22,11 +49,61 @@ namespace gfx
 			virtual long line_height() const = 0;
 			virtual void paint(const std::string& utf8, int x, int y, uint32_t color, Canvas* canvas) const = 0;
 			virtual std::tuple<size_t, size_t> textSize(const std::string& utf8) const = 0;
+
+			// the advance of one code point on its own, without shaping
+			virtual long advance(uint32_t code_point) const = 0;
+
+			// The width of the widest line as a sum of advance()s, without
+			// shaping, rasterizing or allocating. With max_width >= 0 it stops
+			// before the first code point that would make a line wider and
+			// sets break_pos to that code point's byte offset; break_pos is
+			// utf8.size() when everything fits.
+			virtual size_t measure(const std::string& utf8, long max_width = -1, size_t* break_pos = nullptr) const;
+
+			// Paints many strings, skipping the ones that cannot reach the
+			// canvas before any shaping. Backends with a glyph cache place
+			// every string first and then blit all copies of a glyph together,
+			// so overlapping items may blend in another order than with one
+			// paint() per item.
+			virtual void paint_batch(const TextItem* items, size_t count, Canvas* canvas) const;
+
+			// Glyphs paint() has left out so far because they were still being
+			// rasterized in the background; a paint during which this changed
+			// may be incomplete and should not be cached.
+			virtual uint64_t skipped_glyphs() const { return 0; }
+
+			// true when nothing of the item can land on the canvas
+			bool culled(const TextItem& item, const Canvas& canvas) const;
 		};
 
 		typedef std::shared_ptr<Font> ptr;
 
 		ptr builtin();
+
+		// BDF or PSF2, told apart by their contents; the memory has to stay
+		// valid for as long as the font is used. nullptr if it does not parse
+		ptr bitmap(const void* data, size_t size);
+		ptr bitmap(const std::string& path); // maps the file into memory
+
+		// TrueType outlines, pixel_height from the top of the ascender to
+		// the bottom of the descender. Same lifetime rules as bitmap()
+		ptr truetype(const void* data, size_t size, int pixel_height);
+		ptr truetype(const std::string& path, int pixel_height);
+
+		// One typeface at every size. at() makes fonts that share the
+		// face's glyphs, whatever their pixel height
+		struct Face
+		{
+			virtual ~Face() {}
+			virtual ptr at(int pixel_height) = 0;
+		};
+
+		typedef std::shared_ptr<Face> face_ptr;
+
+		// TrueType outlines rendered once as distance fields and scaled when
+		// painted, for text that zooms
+		face_ptr distance_field(const void* data, size_t size);
+		face_ptr distance_field(const std::string& path);
 		//ptr load(const std::string& family_name, int size, bool bold, bool italic);
 	}
 }
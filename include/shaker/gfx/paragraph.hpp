@@ -0,0 +1,74 @@
+#ifndef __GFX_PARAGRAPH_HPP__
+#define __GFX_PARAGRAPH_HPP__
+
+#include <shaker/gfx/font.hpp>
+#include <string>
+#include <vector>
+
+namespace gfx
+{
+	namespace font
+	{
+		// Text wrapped to a width at spaces, and inside words too long for a
+		// line, measured with the font's advance() data.
+		//
+		// Each run of text between two '\n' wraps on its own and remembers the
+		// widths that would wrap it the same way: from its widest line up to
+		// the narrowest width that would pull a word back. A new width only
+		// rewraps the runs it falls outside of, and an edit only the runs it
+		// touches. Lines are kept as byte ranges of the text.
+		class Paragraph
+		{
+		public:
+			enum { NO_WRAP = -1 };
+
+			struct Line
+			{
+				size_t begin, end; // bytes of text(), without the break
+				long width;
+			};
+
+			explicit Paragraph(const ptr& font, const std::string& utf8 = std::string(), long width = NO_WRAP);
+
+			const std::string& text() const { return m_text; }
+			void set_text(const std::string& utf8);
+			// replaces length bytes at begin, which should not split a code point
+			void replace(size_t begin, size_t length, const std::string& utf8);
+
+			long width() const { return m_width; }
+			void set_width(long width);
+
+			size_t lines() const { return m_lines; }
+			Line line(size_t index) const;
+			std::tuple<size_t, size_t> size() const; // widest line, height
+
+			// lines [first, first + count)
+			void paint(int x, int y, uint32_t color, Canvas* canvas, size_t first, size_t count) const;
+			// the lines the canvas shows
+			void paint(int x, int y, uint32_t color, Canvas* canvas) const;
+
+		private:
+			struct Segment
+			{
+				size_t begin, end;       // bytes of text, end at the '\n' or the end of the text
+				size_t first_line;
+				long widest;
+				long overflow;           // the narrowest width that changes the wrap
+				std::vector<Line> lines; // relative to begin
+			};
+
+			void split(size_t begin, size_t end, std::vector<Segment>& out) const;
+			void wrap(Segment& segment) const;
+			void number(size_t from);
+			size_t segment_of_line(size_t index) const;
+
+			ptr m_font;
+			std::string m_text;
+			long m_width;
+			std::vector<Segment> m_segments;
+			size_t m_lines;
+		};
+	}
+}
+
+#endif // __GFX_PARAGRAPH_HPP__
@@ -0,0 +1,48 @@
+#ifndef __GFX_TEXT_CACHE_HPP__
+#define __GFX_TEXT_CACHE_HPP__
+
+#include <shaker/gfx/font.hpp>
+#include <memory>
+
+namespace gfx
+{
+	namespace font
+	{
+		// Wraps another font, painting each string once into an 8-bit coverage
+		// mask and blitting the mask on every later paint, in any color. Meant
+		// for labels repainted unchanged frame after frame.
+		class CachedFont : public Font
+		{
+		public:
+			explicit CachedFont(const ptr& font, size_t budget = 1024 * 1024);
+			~CachedFont();
+
+			long height() const override { return m_font->height(); }
+			long asc() const override { return m_font->asc(); }
+			long desc() const override { return m_font->desc(); }
+			long line_height() const override { return m_font->line_height(); }
+			void paint(const std::string& utf8, int x, int y, uint32_t color, Canvas* canvas) const override;
+			std::tuple<size_t, size_t> textSize(const std::string& utf8) const override { return m_font->textSize(utf8); }
+			long advance(uint32_t code_point) const override { return m_font->advance(code_point); }
+			size_t measure(const std::string& utf8, long max_width = -1, size_t* break_pos = nullptr) const override
+			{
+				return m_font->measure(utf8, max_width, break_pos);
+			}
+			uint64_t skipped_glyphs() const override { return m_font->skipped_glyphs(); }
+
+			void limit(size_t bytes);
+			CacheStats stats() const;
+
+		private:
+			struct Runs;
+
+			CachedFont(const CachedFont&);
+			CachedFont& operator=(const CachedFont&);
+
+			ptr m_font;
+			std::unique_ptr<Runs> m_runs;
+		};
+	}
+}
+
+#endif // __GFX_TEXT_CACHE_HPP__
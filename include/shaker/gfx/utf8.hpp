@@ -1,7 +1,9 @@
 #ifndef __GFX_UTF8_HPP__
 #define __GFX_UTF8_HPP__
 
+#include <iterator>
 #include <string>
+#include <stddef.h>
 #include <stdint.h>
 
 namespace std
@@ -115,13 +117,86 @@ namespace utf8
 		return result;
 	}
 
+	// The code points of [begin, end) written to out, which has room for
+	// end - begin of them; returns how many. Same results as to32(), with
+	// runs of ASCII widened 16 bytes at a time.
+	size_t decode(const char* begin, const char* end, uint32_t* out);
+
+	// UTF-16 code units of [begin, end), with surrogate pairs above the
+	// BMP, written to out, which has room for end - begin of them; returns
+	// how many. Code points that UTF-16 cannot carry, surrogates and those
+	// above U+10FFFF, become UCS_REPLACEMENT.
+	size_t to16(const char* begin, const char* end, uint16_t* out);
+	size_t to16(const char* begin, const char* end, wchar_t* out);
+
 	inline ustring to32(const string& s)
 	{
-		ustring out;
-		out.reserve(s.length());
-		to32(s.begin(), s.end(), std::back_inserter(out));
+		ustring out(s.length(), 0);
+		if (!s.empty())
+			out.resize(decode(s.data(), s.data() + s.size(), &out[0]));
 		return out;
 	}
+
+	// Decodes while iterating, without copying the text:
+	//   for (auto code_point : utf8::view(text)) ...
+	class view
+	{
+		const char* m_begin;
+		const char* m_end;
+
+	public:
+		class iterator
+		{
+			const char* m_cur;
+			const char* m_next;
+			const char* m_end;
+			uint32_t m_code_point;
+
+			void decode()
+			{
+				m_next = m_cur;
+				if (m_cur == m_end)
+					return;
+
+				uint8_t lead = impl::mask8(*m_cur);
+				if (lead < 0x80)
+				{
+					m_code_point = lead;
+					++m_next;
+				}
+				else if (!impl::next(m_next, m_end, m_code_point))
+				{
+					m_code_point = UCS_REPLACEMENT;
+					++m_next;
+				}
+			}
+
+		public:
+			typedef std::forward_iterator_tag iterator_category;
+			typedef uint32_t value_type;
+			typedef ptrdiff_t difference_type;
+			typedef const uint32_t* pointer;
+			typedef const uint32_t& reference;
+
+			iterator(const char* cur, const char* end) : m_cur(cur), m_end(end), m_code_point(0) { decode(); }
+
+			const uint32_t& operator*() const { return m_code_point; }
+			iterator& operator++() { m_cur = m_next; decode(); return *this; }
+			iterator operator++(int) { iterator out = *this; ++*this; return out; }
+			bool operator==(const iterator& other) const { return m_cur == other.m_cur; }
+			bool operator!=(const iterator& other) const { return m_cur != other.m_cur; }
+
+			// the bytes of the current code point
+			const char* position() const { return m_cur; }
+			const char* next() const { return m_next; }
+		};
+
+		view(const char* begin, const char* end) : m_begin(begin), m_end(end) {}
+		explicit view(const string& s) : m_begin(s.data()), m_end(s.data() + s.size()) {}
+
+		iterator begin() const { return iterator(m_begin, m_end); }
+		iterator end() const { return iterator(m_end, m_end); }
+	};
 }
 
 #endif // __GFX_UTF8_HPP__
@@ -0,0 +1,148 @@
+#ifndef __GFX_VIDEO_HPP__
+#define __GFX_VIDEO_HPP__
+
+#include <shaker/gfx/yuv.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace gfx
+{
+	namespace video
+	{
+		struct Latency
+		{
+			uint32_t last_us;
+			uint32_t average_us; // exponential, 1/16 weight of the newest sample
+			uint32_t max_us;
+		};
+
+		struct Stats
+		{
+			size_t queued;          // submitted, waiting for a worker
+			size_t converting;
+			size_t ready;           // converted, waiting for the presenter
+			uint64_t submitted;
+			uint64_t presented;
+			uint64_t dropped_queued; // reclaimed by acquire() before conversion
+			uint64_t dropped_ready;  // converted, but superseded by a newer frame
+			Latency queue;           // submit() to conversion start
+			Latency convert;         // conversion itself
+			Latency present;         // conversion end to take()
+		};
+
+		// Decoder -> conversion workers -> presenter, each on its own thread.
+		//
+		// The decoder fills preallocated frames from acquire() and hands them
+		// over with submit(). Workers convert the oldest queued frame into a
+		// pooled surface. At flush time the presenter take()s the newest ready
+		// surface, any older ready surfaces are dropped, and release()s it
+		// once it has been painted.
+		class Pipeline
+		{
+		public:
+			struct Settings
+			{
+				yuv::Layout layout;
+				yuv::Matrix matrix;
+				yuv::Range range;
+				int width, height;
+				int queue_depth; // preallocated input frames
+				int surfaces;    // output surfaces, including the ones held by the presenter
+				int workers;
+
+				Settings(yuv::Layout layout, int width, int height)
+					: layout(layout)
+					, matrix(yuv::BT601)
+					, range(yuv::Limited)
+					, width(width)
+					, height(height)
+					, queue_depth(3)
+					, surfaces(3)
+					, workers(1)
+				{
+				}
+			};
+
+			struct Surface
+			{
+				std::vector<uint32_t> pixels; // width * height native-order pixels
+				int width, height;
+				int64_t timestamp;
+			};
+
+			explicit Pipeline(const Settings& settings);
+			~Pipeline();
+
+			// Decoder side. acquire() returns a free frame; with all frames
+			// queued it reclaims the oldest one not yet converted, and returns
+			// nullptr only when every frame is being filled or converted.
+			yuv::Frame* acquire();
+			void submit(yuv::Frame* frame, int64_t timestamp);
+			void discard(yuv::Frame* frame);
+
+			// Presenter side. take() returns nullptr if nothing new is ready.
+			const Surface* take();
+			void release(const Surface* surface);
+
+			Stats stats() const;
+
+		private:
+			typedef std::chrono::steady_clock clock;
+
+			enum State
+			{
+				FREE,
+				ACQUIRED,
+				QUEUED,
+				BUSY,
+				READY,
+				TAKEN
+			};
+
+			struct Input
+			{
+				yuv::Frame frame;
+				std::vector<uint8_t> buffer;
+				State state;
+				uint64_t sequence;
+				int64_t timestamp;
+				clock::time_point submitted;
+
+				Input(const Settings& settings);
+			};
+
+			struct Output
+			{
+				Surface surface;
+				State state;
+				uint64_t sequence;
+				clock::time_point converted;
+			};
+
+			Pipeline(const Pipeline&);
+			Pipeline& operator=(const Pipeline&);
+
+			Input* input(const yuv::Frame* frame);
+			Input* oldest(State state);
+			Output* output();
+			void work();
+			static void measure(Latency& latency, clock::duration elapsed);
+
+			mutable std::mutex m;
+			std::condition_variable m_work;
+			std::vector<std::unique_ptr<Input>> m_inputs;
+			std::vector<std::unique_ptr<Output>> m_outputs;
+			std::vector<std::thread> m_workers;
+			bool m_stop;
+			uint64_t m_sequence;
+			uint64_t m_presented;
+			Stats m_stats;
+		};
+	}
+}
+
+#endif // __GFX_VIDEO_HPP__
@@ -0,0 +1,170 @@
+#ifndef __GFX_YUV_HPP__
+#define __GFX_YUV_HPP__
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace pp
+{
+	class ImageData;
+}
+
+namespace gfx
+{
+	class Canvas;
+	class Bitmap;
+
+	namespace yuv
+	{
+		enum Layout
+		{
+			I420, // Y, U, V planes, chroma halved in both directions
+			NV12, // Y plane, interleaved UV plane, chroma halved in both directions
+			NV21, // Y plane, interleaved VU plane, chroma halved in both directions
+			I422, // Y, U, V planes, chroma halved horizontally
+			I444, // Y, U, V planes, full resolution chroma
+			YUY2  // one packed plane of Y0 U Y1 V quads
+		};
+
+		enum Matrix
+		{
+			BT601,
+			BT709,
+			BT2020
+		};
+
+		enum Range
+		{
+			Limited, // Y in 16..235, chroma in 16..240
+			Full
+		};
+
+		// YUV to RGB coefficients in 8.8 fixed point:
+		//   R = Y_MUL * (y - Y_OFFSET) + V_TO_R * (v - 128)
+		//   G = Y_MUL * (y - Y_OFFSET) - U_TO_G * (u - 128) - V_TO_G * (v - 128)
+		//   B = Y_MUL * (y - Y_OFFSET) + U_TO_B * (u - 128)
+		template <Matrix M, Range R> struct Coefficients;
+
+#define YUV_COEFFICIENTS(M, R, OFFSET, MUL, VR, UG, VG, UB) \
+		template <> struct Coefficients<M, R> \
+		{ \
+			enum { Y_OFFSET = OFFSET, Y_MUL = MUL, V_TO_R = VR, U_TO_G = UG, V_TO_G = VG, U_TO_B = UB }; \
+		}
+
+		YUV_COEFFICIENTS(BT601,  Limited, 16, 298, 409, 100, 208, 516);
+		YUV_COEFFICIENTS(BT601,  Full,     0, 256, 359,  88, 183, 454);
+		YUV_COEFFICIENTS(BT709,  Limited, 16, 298, 459,  55, 136, 541);
+		YUV_COEFFICIENTS(BT709,  Full,     0, 256, 403,  48, 120, 475);
+		YUV_COEFFICIENTS(BT2020, Limited, 16, 298, 430,  48, 167, 548);
+		YUV_COEFFICIENTS(BT2020, Full,     0, 256, 377,  42, 146, 482);
+#undef YUV_COEFFICIENTS
+
+		// RGB to YUV coefficients in 8.8 fixed point, the inverse of Coefficients:
+		//   y = Y_OFFSET + (R_TO_Y * R + G_TO_Y * G + B_TO_Y * B)
+		//   u = 128 + (R_TO_U * R + G_TO_U * G + B_TO_U * B)
+		//   v = 128 + (R_TO_V * R + G_TO_V * G + B_TO_V * B)
+		template <Matrix M, Range R> struct EncodeCoefficients;
+
+#define YUV_ENCODE_COEFFICIENTS(M, R, OFFSET, RY, GY, BY, RU, GU, BU, RV, GV, BV) \
+		template <> struct EncodeCoefficients<M, R> \
+		{ \
+			enum { Y_OFFSET = OFFSET, R_TO_Y = RY, G_TO_Y = GY, B_TO_Y = BY, R_TO_U = RU, G_TO_U = GU, B_TO_U = BU, R_TO_V = RV, G_TO_V = GV, B_TO_V = BV }; \
+		}
+
+		YUV_ENCODE_COEFFICIENTS(BT601,  Limited, 16, 66, 129, 25, -38,  -74, 112, 112,  -94, -18);
+		YUV_ENCODE_COEFFICIENTS(BT601,  Full,     0, 77, 150, 29, -43,  -85, 128, 128, -107, -21);
+		YUV_ENCODE_COEFFICIENTS(BT709,  Limited, 16, 47, 157, 16, -26,  -86, 112, 112, -102, -10);
+		YUV_ENCODE_COEFFICIENTS(BT709,  Full,     0, 54, 184, 18, -29,  -99, 128, 128, -116, -12);
+		YUV_ENCODE_COEFFICIENTS(BT2020, Limited, 16, 58, 149, 13, -31,  -81, 112, 112, -103,  -9);
+		YUV_ENCODE_COEFFICIENTS(BT2020, Full,     0, 67, 174, 15, -36,  -92, 128, 128, -118, -10);
+#undef YUV_ENCODE_COEFFICIENTS
+
+		struct Plane
+		{
+			uint8_t* data;
+			int stride; // in bytes
+
+			Plane(uint8_t* data = nullptr, int stride = 0) : data(data), stride(stride) {}
+		};
+
+		struct Frame
+		{
+			Layout layout;
+			Matrix matrix;
+			Range range;
+			int width, height;
+			Plane planes[3]; // Y, U, V / Y, UV / YUYV, depending on the layout
+
+			Frame(Layout layout, int width, int height, const Plane& p0, const Plane& p1 = Plane(), const Plane& p2 = Plane())
+				: layout(layout)
+				, matrix(BT601)
+				, range(Limited)
+				, width(width)
+				, height(height)
+			{
+				planes[0] = p0;
+				planes[1] = p1;
+				planes[2] = p2;
+			}
+
+			// describes a tightly packed buffer, the way most decoders hand them out
+			static Frame packed(Layout layout, int width, int height, void* buffer);
+			static size_t packed_size(Layout layout, int width, int height);
+
+			static int chroma_shift_x(Layout layout) { return layout == I444 ? 0 : 1; }
+			static int chroma_shift_y(Layout layout) { return layout == I420 || layout == NV12 || layout == NV21 ? 1 : 0; }
+			int chroma_width() const { return (width + (1 << chroma_shift_x(layout)) - 1) >> chroma_shift_x(layout); }
+			int chroma_height() const { return (height + (1 << chroma_shift_y(layout)) - 1) >> chroma_shift_y(layout); }
+		};
+
+		struct Rect
+		{
+			int x, y, width, height;
+
+			Rect(int x, int y, int width, int height) : x(x), y(y), width(width), height(height) {}
+		};
+
+		enum Filter
+		{
+			Nearest,
+			Bilinear
+		};
+
+		// converts the whole frame to native-order pixels;
+		// out_stride is in pixels, 0 means the frame width
+		void convert(const Frame& frame, uint32_t* out, int out_stride = 0);
+
+		// Converts the crop window of the frame, which may start and end on odd
+		// coordinates; chroma is sampled where it is sited in the full frame.
+		// The window is clipped to the frame first, and what is left is
+		// written from out[0], with out_stride defaulting to its width. A
+		// window starting at negative coordinates therefore does not keep its
+		// place in out: Rect(-8, 0, w, h) writes frame column 0 to out[0].
+		void convert(const Frame& frame, Rect crop, uint32_t* out, int out_stride = 0);
+
+		// same, with the destination stride in bytes (e.g. pp::ImageData::stride())
+		void convert(const Frame& frame, Rect crop, void* out, int out_stride_bytes);
+
+		// converts the frame 1:1 with its top-left corner at (x, y), clipped to the
+		// destination, so frames can go straight into a presentable ImageData
+		void convert(const Frame& frame, Canvas* canvas, int x, int y);
+		void convert(const Frame& frame, pp::ImageData& image, int x = 0, int y = 0);
+
+		// converts the whole frame resampled to the w x h rectangle at (x, y) of the canvas,
+		// in one pass over the planes; the rectangle is clipped to the canvas
+		void convert(const Frame& frame, Canvas* canvas, int x, int y, int w, int h, Filter filter = Bilinear);
+		void convert(const Frame& frame, Rect crop, Canvas* canvas, int x, int y, int w, int h, Filter filter = Bilinear);
+
+		// Converts native-order pixels into the frame, which must be I420 or NV12;
+		// frame.matrix and frame.range select the coefficients and each chroma
+		// sample is the average of its 2x2 block. Rows are split into bands
+		// converted by up to `threads` threads, the calling one included. The
+		// helper threads are made on first use and kept for later calls, so
+		// encoding every frame of a video does not create threads.
+		void encode(const uint32_t* pixels, int stride, const Frame& frame, int threads = 1);
+		void encode(const Bitmap& bmp, const Frame& frame, int threads = 1);
+		void encode(const Canvas& canvas, const Frame& frame, int threads = 1);
+	}
+}
+
+#endif // __GFX_YUV_HPP__
@@ -0,0 +1,56 @@
+#ifndef __GFX_YUV_INCREMENTAL_HPP__
+#define __GFX_YUV_INCREMENTAL_HPP__
+
+#include <shaker/gfx/yuv.hpp>
+#include <vector>
+
+namespace gfx
+{
+	namespace yuv
+	{
+		// Converts only the 16x16 macroblocks that differ from the previous frame.
+		//
+		// Keeps a copy of the previous frame's planes and compares each block
+		// against it. The output buffer has to be the same one between calls,
+		// since unchanged blocks are not written. The returned damage list
+		// holds the changed blocks, merged into horizontal runs.
+		class Incremental
+		{
+		public:
+			enum { BLOCK = 16 };
+
+			Incremental();
+
+			const std::vector<Rect>& update(const Frame& frame, uint32_t* out, int out_stride = 0);
+
+			// forces the next update() to convert the whole frame
+			void reset();
+
+			const std::vector<Rect>& damage() const { return m_damage; }
+
+		private:
+			struct Plane
+			{
+				std::vector<uint8_t> pixels;
+				int stride;
+				int h_shift, v_shift, bpp;
+			};
+
+			bool matches(const Frame& frame) const;
+			void remember(const Frame& frame);
+			bool changed(const Frame& frame, const Rect& block) const;
+			void copy(const Frame& frame, const Rect& rect);
+
+			Layout m_layout;
+			Matrix m_matrix;
+			Range m_range;
+			int m_width, m_height;
+			bool m_valid;
+			Plane m_planes[3];
+			int m_plane_count;
+			std::vector<Rect> m_damage;
+		};
+	}
+}
+
+#endif // __GFX_YUV_INCREMENTAL_HPP__
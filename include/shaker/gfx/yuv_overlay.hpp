@@ -0,0 +1,32 @@
+#ifndef __GFX_YUV_OVERLAY_HPP__
+#define __GFX_YUV_OVERLAY_HPP__
+
+#include <shaker/gfx/yuv.hpp>
+
+namespace gfx
+{
+	namespace yuv
+	{
+		// Overlays (captions, OSD) composited straight into the planes of a
+		// frame before it is converted, so no second pass over RGB is needed.
+		// Luma is blended per pixel; each chroma sample is blended with the
+		// average coverage of the luma pixels it covers.
+
+		struct Color
+		{
+			uint8_t y, u, v, a;
+		};
+
+		// 0xAARRGGBB to the given matrix and range
+		Color color(uint32_t argb, Matrix matrix, Range range);
+		inline Color color(uint32_t argb, const Frame& frame) { return color(argb, frame.matrix, frame.range); }
+
+		// the rectangle is clipped to the frame
+		void fill(const Frame& frame, const Rect& rect, const Color& color);
+
+		// 8-bit coverage mask with its top-left corner at (x, y), scaled by color.a
+		void blend(const Frame& frame, int x, int y, const uint8_t* mask, int width, int height, int stride, const Color& color);
+	}
+}
+
+#endif // __GFX_YUV_OVERLAY_HPP__
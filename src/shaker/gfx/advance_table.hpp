@@ -0,0 +1,80 @@
+#ifndef __GFX_ADVANCE_TABLE_HPP__
+#define __GFX_ADVANCE_TABLE_HPP__
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+
+namespace gfx
+{
+	namespace font
+	{
+		// Advance widths of the BMP, one array of PAGE_SIZE code points per
+		// page, each page filled the first time one of its code points is
+		// asked for. Filled pages are read without locking. Code points
+		// above the BMP are not kept and ask fill() every time.
+		class AdvanceTable
+		{
+		public:
+			enum
+			{
+				PAGE_BITS = 8,
+				PAGE_SIZE = 1 << PAGE_BITS,
+				PAGES = 0x10000 >> PAGE_BITS
+			};
+
+			AdvanceTable()
+			{
+				for (int i = 0; i < PAGES; ++i)
+					m_pages[i].store(nullptr, std::memory_order_relaxed);
+			}
+
+			~AdvanceTable()
+			{
+				for (int i = 0; i < PAGES; ++i)
+					delete[] m_pages[i].load(std::memory_order_relaxed);
+			}
+
+			// fill(first, count, advances) writes the advances of code
+			// points [first, first + count)
+			template <typename Fill>
+			int32_t get(uint32_t code_point, Fill fill) const
+			{
+				if (code_point > 0xFFFF)
+				{
+					int32_t out = 0;
+					fill(code_point, 1, &out);
+					return out;
+				}
+
+				auto page = m_pages[code_point >> PAGE_BITS].load(std::memory_order_acquire);
+				if (!page)
+					page = load(code_point >> PAGE_BITS, fill);
+				return page[code_point & (PAGE_SIZE - 1)];
+			}
+
+		private:
+			AdvanceTable(const AdvanceTable&);
+			AdvanceTable& operator=(const AdvanceTable&);
+
+			template <typename Fill>
+			const int32_t* load(uint32_t index, Fill fill) const
+			{
+				std::lock_guard<std::mutex> lock(m);
+				auto page = m_pages[index].load(std::memory_order_relaxed);
+				if (page)
+					return page;
+
+				int32_t* fresh = new int32_t[PAGE_SIZE];
+				fill(index << PAGE_BITS, (int)PAGE_SIZE, fresh);
+				m_pages[index].store(fresh, std::memory_order_release);
+				return fresh;
+			}
+
+			mutable std::mutex m;
+			mutable std::atomic<const int32_t*> m_pages[PAGES];
+		};
+	}
+}
+
+#endif // __GFX_ADVANCE_TABLE_HPP__
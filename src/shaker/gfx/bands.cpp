@@ -0,0 +1,70 @@
+#include "bands.hpp"
+
+namespace gfx
+{
+	BandPool& BandPool::instance()
+	{
+		static BandPool* self = new BandPool;
+		return *self;
+	}
+
+	BandPool::BandPool()
+		: m_fn(nullptr)
+		, m_count(0)
+		, m_bands(0)
+		, m_next(0)
+		, m_remaining(0)
+	{
+	}
+
+	void BandPool::run(int count, int bands, const band_fn& fn)
+	{
+		std::lock_guard<std::mutex> job(m_job);
+
+		std::unique_lock<std::mutex> lock(m);
+		while ((int)m_threads.size() < bands - 1)
+			m_threads.push_back(std::thread([this]{ work(); }));
+
+		m_fn = &fn;
+		m_count = count;
+		m_bands = bands;
+		m_next = 0;
+		m_remaining = bands;
+		m_work.notify_all();
+
+		while (next(lock))
+			;
+
+		m_done.wait(lock, [this]{ return !m_remaining; });
+		m_fn = nullptr;
+	}
+
+	bool BandPool::next(std::unique_lock<std::mutex>& lock)
+	{
+		if (m_next >= m_bands)
+			return false;
+
+		int band = m_next++;
+		int begin = (int)((int64_t)m_count * band / m_bands);
+		int end = (int)((int64_t)m_count * (band + 1) / m_bands);
+		const band_fn& fn = *m_fn;
+
+		lock.unlock();
+		fn(begin, end);
+		lock.lock();
+
+		if (!--m_remaining)
+			m_done.notify_all();
+		return true;
+	}
+
+	void BandPool::work()
+	{
+		std::unique_lock<std::mutex> lock(m);
+		for (;;)
+		{
+			m_work.wait(lock, [this]{ return m_next < m_bands; });
+			next(lock);
+		}
+	}
+}
@@ -0,0 +1,70 @@
+#ifndef __GFX_BANDS_HPP__
+#define __GFX_BANDS_HPP__
+
+#include <stdint.h>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace gfx
+{
+	// Threads kept across bands() calls, so converting 60 frames a second
+	// does not create and join the helpers for every frame. Grows to the
+	// most threads ever asked for; one job runs at a time, callers queue on
+	// run(). Never destroyed: its threads end with the process, since
+	// joining them while a DLL unloads can hang.
+	class BandPool
+	{
+	public:
+		typedef std::function<void(int, int)> band_fn;
+
+		static BandPool& instance();
+
+		// fn(begin, end) for `bands` contiguous bands of [0, count), the
+		// calling thread taking its share
+		void run(int count, int bands, const band_fn& fn);
+
+	private:
+		BandPool();
+		BandPool(const BandPool&);
+		BandPool& operator=(const BandPool&);
+
+		void work();
+		// runs the next band with m unlocked, false when all are taken
+		bool next(std::unique_lock<std::mutex>& lock);
+
+		std::mutex m_job;
+		std::mutex m;
+		std::condition_variable m_work;
+		std::condition_variable m_done;
+		std::vector<std::thread> m_threads;
+		const band_fn* m_fn;
+		int m_count;
+		int m_bands;
+		int m_next;      // the first band not taken yet
+		int m_remaining; // bands not finished yet
+	};
+
+	// Splits [0, count) into up to `threads` contiguous bands and calls
+	// fn(begin, end) for each of them, on the calling thread and the
+	// BandPool's.
+	template <typename Fn>
+	void bands(int count, int threads, Fn fn)
+	{
+		if (threads > count)
+			threads = count;
+
+		if (threads <= 1)
+		{
+			if (count > 0)
+				fn(0, count);
+			return;
+		}
+
+		BandPool::instance().run(count, threads, BandPool::band_fn(fn));
+	}
+}
+
+#endif // __GFX_BANDS_HPP__
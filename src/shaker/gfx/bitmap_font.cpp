@@ -0,0 +1,464 @@
+#include "bitmap_font.hpp"
+#include <shaker/gfx/alpha_mask.hpp>
+#include <shaker/gfx/utf8.hpp>
+#include "mapping.hpp"
+#include <string.h>
+
+namespace gfx { namespace font
+{
+	namespace
+	{
+		// BDF is line based text
+		struct Lines
+		{
+			const char* cur;
+			const char* end;
+
+			Lines(const uint8_t* data, size_t size) : cur((const char*)data), end((const char*)data + size) {}
+
+			bool next(const char*& line, const char*& eol)
+			{
+				if (cur >= end)
+					return false;
+
+				line = cur;
+				eol = (const char*)memchr(cur, '\n', end - cur);
+				if (!eol)
+					eol = end;
+				cur = eol + 1;
+				return true;
+			}
+		};
+
+		bool keyword(const char*& line, const char* eol, const char* name)
+		{
+			size_t length = strlen(name);
+			if ((size_t)(eol - line) < length || memcmp(line, name, length))
+				return false;
+			if (line + length != eol && line[length] != ' ' && line[length] != '\t' && line[length] != '\r')
+				return false;
+			line += length;
+			return true;
+		}
+
+		int number(const char*& cur, const char* end)
+		{
+			while (cur < end && (*cur == ' ' || *cur == '\t'))
+				++cur;
+
+			bool negative = cur < end && *cur == '-';
+			if (negative)
+				++cur;
+
+			int out = 0;
+			while (cur < end && *cur >= '0' && *cur <= '9')
+				out = out * 10 + (*cur++ - '0');
+			return negative ? -out : out;
+		}
+
+		int hex(char c)
+		{
+			if (c >= '0' && c <= '9') return c - '0';
+			if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+			if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+			return 0;
+		}
+
+		uint32_t le32(const uint8_t* p)
+		{
+			return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+		}
+
+		// One UTF-8 code point of a PSF2 table entry. Every trailing byte has
+		// to be 0x80-0xBF, so a truncated sequence stops on the 0xFE or 0xFF
+		// after it instead of swallowing it; cur is left on the byte that
+		// broke the sequence, or past the lead byte if that was the bad one.
+		bool entry_code_point(const uint8_t*& cur, const uint8_t* end, uint32_t& out)
+		{
+			uint8_t lead = *cur;
+			int trailing =
+				lead < 0x80 ? 0 :
+				lead >= 0xC2 && lead < 0xE0 ? 1 :
+				lead >= 0xE0 && lead < 0xF0 ? 2 :
+				lead >= 0xF0 && lead < 0xF5 ? 3 : -1;
+
+			if (trailing < 0)
+			{
+				++cur;
+				return false;
+			}
+
+			uint32_t code_point = trailing ? lead & (0x3F >> trailing) : lead;
+			const uint8_t* next = cur + 1;
+			for (int i = 0; i < trailing; ++i, ++next)
+			{
+				if (next >= end || (*next & 0xC0) != 0x80)
+				{
+					cur = next;
+					return false;
+				}
+				code_point = (code_point << 6) | (*next & 0x3F);
+			}
+
+			cur = next;
+			out = code_point;
+			return code_point <= 0x10FFFF;
+		}
+
+		static const uint32_t PSF2_MAGIC = 0x864ab572;
+		static const uint32_t PSF2_HAS_UNICODE_TABLE = 1;
+		static const size_t PSF2_HEADER = 32;
+	}
+
+	BitmapFont::BitmapFont(const uint8_t* data, size_t size, const owner_ptr& owner, Format format)
+		: m_data(data)
+		, m_size(size)
+		, m_owner(owner)
+		, m_format(format)
+		, m_asc(0)
+		, m_desc(0)
+		, m_default(-1)
+		, m_directory(CODE_POINTS >> PAGE_BITS)
+		, m_decoded(CACHE_BYTES)
+	{
+	}
+
+	std::shared_ptr<BitmapFont> BitmapFont::load(const uint8_t* data, size_t size, const owner_ptr& owner)
+	{
+		if (!data)
+			return nullptr;
+
+		std::shared_ptr<BitmapFont> font;
+		if (size >= PSF2_HEADER && le32(data) == PSF2_MAGIC)
+		{
+			font.reset(new BitmapFont(data, size, owner, PSF2));
+			if (!font->parse_psf2())
+				return nullptr;
+		}
+		else if (size > 9 && !memcmp(data, "STARTFONT", 9))
+		{
+			font.reset(new BitmapFont(data, size, owner, BDF));
+			if (!font->parse_bdf())
+				return nullptr;
+		}
+
+		return font;
+	}
+
+	void BitmapFont::map(uint32_t code_point, uint32_t glyph)
+	{
+		if (code_point >= CODE_POINTS)
+			return;
+
+		auto& page = m_directory[code_point >> PAGE_BITS];
+		if (!page)
+		{
+			m_pages.resize(m_pages.size() + PAGE_SIZE);
+			page = (uint16_t)(m_pages.size() / PAGE_SIZE);
+		}
+
+		// the first glyph claiming a code point wins
+		auto& slot = m_pages[(page - 1) * PAGE_SIZE + (code_point & (PAGE_SIZE - 1))];
+		if (!slot)
+			slot = glyph + 1;
+	}
+
+	int BitmapFont::lookup(uint32_t code_point) const
+	{
+		if (code_point >= CODE_POINTS)
+			return -1;
+
+		auto page = m_directory[code_point >> PAGE_BITS];
+		if (!page)
+			return -1;
+
+		return (int)m_pages[(page - 1) * PAGE_SIZE + (code_point & (PAGE_SIZE - 1))] - 1;
+	}
+
+	// one pass over the file, recording where each glyph's rows start
+	bool BitmapFont::parse_bdf()
+	{
+		Lines lines(m_data, m_size);
+		const char* line;
+		const char* eol;
+
+		int box_height = 0, box_y = 0, box_width = 0;
+		int default_char = -1;
+		bool ascent = false, descent = false;
+		int encoding = -1;
+		Glyph glyph = {};
+
+		while (lines.next(line, eol))
+		{
+			if (keyword(line, eol, "FONTBOUNDINGBOX"))
+			{
+				box_width = number(line, eol);
+				box_height = number(line, eol);
+				number(line, eol);
+				box_y = number(line, eol);
+			}
+			else if (keyword(line, eol, "FONT_ASCENT"))
+			{
+				m_asc = number(line, eol);
+				ascent = true;
+			}
+			else if (keyword(line, eol, "FONT_DESCENT"))
+			{
+				m_desc = number(line, eol);
+				descent = true;
+			}
+			else if (keyword(line, eol, "DEFAULT_CHAR"))
+			{
+				default_char = number(line, eol);
+			}
+			else if (keyword(line, eol, "CHARS"))
+			{
+				m_glyphs.reserve(number(line, eol));
+			}
+			else if (keyword(line, eol, "STARTCHAR"))
+			{
+				Glyph empty = { 0, 0, 0, 0, 0, (int16_t)box_width };
+				glyph = empty;
+				encoding = -1;
+			}
+			else if (keyword(line, eol, "ENCODING"))
+			{
+				encoding = number(line, eol);
+			}
+			else if (keyword(line, eol, "DWIDTH"))
+			{
+				glyph.advance = (int16_t)number(line, eol);
+			}
+			else if (keyword(line, eol, "BBX"))
+			{
+				int w = number(line, eol);
+				int h = number(line, eol);
+				int x = number(line, eol);
+				int y = number(line, eol);
+				glyph.width = (int16_t)w;
+				glyph.height = (int16_t)h;
+				glyph.x = (int16_t)x;
+				glyph.y = (int16_t)-(h + y);
+			}
+			else if (keyword(line, eol, "BITMAP"))
+			{
+				glyph.offset = (uint32_t)(lines.cur - (const char*)m_data);
+			}
+			else if (keyword(line, eol, "ENDCHAR"))
+			{
+				if (encoding < 0 || glyph.width < 0 || glyph.height < 0)
+					continue;
+
+				map(encoding, (uint32_t)m_glyphs.size());
+				m_glyphs.push_back(glyph);
+			}
+		}
+
+		if (!ascent)
+			m_asc = box_height + box_y;
+		if (!descent)
+			m_desc = -box_y;
+
+		m_default = default_char >= 0 ? lookup(default_char) : -1;
+		if (m_default < 0)
+			m_default = lookup(utf8::UCS_REPLACEMENT);
+		if (m_default < 0)
+			m_default = lookup('?');
+
+		return !m_glyphs.empty();
+	}
+
+	bool BitmapFont::parse_psf2()
+	{
+		uint32_t header = le32(m_data + 8);
+		uint32_t flags = le32(m_data + 12);
+		uint32_t length = le32(m_data + 16);
+		uint32_t charsize = le32(m_data + 20);
+		uint32_t height = le32(m_data + 24);
+		uint32_t width = le32(m_data + 28);
+
+		if (!length || !width || !height || width > 0x7FFF || height > 0x7FFF)
+			return false;
+		if (charsize < height * ((width + 7) / 8))
+			return false;
+		if (header > m_size || (m_size - header) / charsize < length)
+			return false;
+
+		// PSF has no baseline, put a quarter of the cell under it
+		m_desc = height / 4;
+		m_asc = height - m_desc;
+
+		m_glyphs.resize(length);
+		for (uint32_t i = 0; i < length; ++i)
+		{
+			Glyph glyph = { header + i * charsize, (int16_t)width, (int16_t)height, 0, (int16_t)-m_asc, (int16_t)width };
+			m_glyphs[i] = glyph;
+		}
+
+		if (!(flags & PSF2_HAS_UNICODE_TABLE))
+		{
+			for (uint32_t i = 0; i < length; ++i)
+				map(i, i);
+		}
+		else
+		{
+			// per glyph: UTF-8 code points, then 0xFE-prefixed sequences, then 0xFF
+			const uint8_t* cur = m_data + header + length * charsize;
+			const uint8_t* end = m_data + m_size;
+			for (uint32_t i = 0; i < length && cur < end; ++i)
+			{
+				while (cur < end && *cur != 0xFF && *cur != 0xFE)
+				{
+					uint32_t code_point;
+					if (entry_code_point(cur, end, code_point))
+						map(code_point, i);
+				}
+
+				// combining sequences are not supported
+				while (cur < end && *cur != 0xFF)
+					++cur;
+				++cur;
+			}
+		}
+
+		m_default = lookup(utf8::UCS_REPLACEMENT);
+		if (m_default < 0)
+			m_default = lookup('?');
+
+		return true;
+	}
+
+	std::shared_ptr<BitmapFont::Decoded> BitmapFont::decode(int index) const
+	{
+		return m_decoded.get(index, [this, index]() -> std::shared_ptr<Decoded>
+		{
+			const Glyph& glyph = m_glyphs[index];
+			auto out = std::make_shared<Decoded>();
+			out->coverage.resize(glyph.width * glyph.height);
+
+			int bytes = (glyph.width + 7) / 8;
+			const uint8_t* cur = m_data + glyph.offset;
+			const uint8_t* end = m_data + m_size;
+
+			for (int y = 0; y < glyph.height; ++y)
+			{
+				uint8_t* dst = out->coverage.data() + y * glyph.width;
+				for (int x = 0; x < glyph.width; ++x)
+				{
+					int bit = 7 - (x & 7);
+					int byte;
+					if (m_format == PSF2)
+					{
+						byte = cur[y * bytes + (x >> 3)];
+					}
+					else
+					{
+						const uint8_t* digits = cur + (x >> 3) * 2;
+						if (digits + 1 >= end)
+							break;
+						byte = (hex(digits[0]) << 4) | hex(digits[1]);
+					}
+					dst[x] = (byte >> bit) & 1 ? 0xFF : 0x00;
+				}
+
+				// BDF rows are lines of hex digits
+				if (m_format == BDF)
+				{
+					auto eol = (const uint8_t*)memchr(cur, '\n', end - cur);
+					if (!eol)
+						break;
+					cur = eol + 1;
+				}
+			}
+
+			return out;
+		});
+	}
+
+	void BitmapFont::paint(const std::string& utf8, int x, int y, uint32_t color, Canvas* canvas) const
+	{
+		color |= 0xFF000000;
+
+		auto cr = x;
+		y += m_asc;
+
+		for (auto code_point : utf8::view(utf8))
+		{
+			if (code_point == '\n')
+			{
+				y += line_height();
+				x = cr;
+				continue;
+			}
+
+			int index = lookup(code_point);
+			if (index < 0)
+				index = m_default;
+			if (index < 0)
+				continue;
+
+			const Glyph& glyph = m_glyphs[index];
+			if (glyph.width && glyph.height)
+			{
+				auto decoded = decode(index);
+				if (decoded)
+					canvas->fill_mask(x + glyph.x, y + glyph.y, AlphaMask(decoded->coverage.data(), glyph.width, glyph.height), color);
+			}
+
+			x += glyph.advance;
+		}
+	}
+
+	std::tuple<size_t, size_t> BitmapFont::textSize(const std::string& utf8) const
+	{
+		size_t width = 0;
+		size_t lines = 1;
+		long line = 0;
+
+		for (auto code_point : utf8::view(utf8))
+		{
+			if (code_point == '\n')
+			{
+				if ((long)width < line)
+					width = line;
+				line = 0;
+				++lines;
+				continue;
+			}
+
+			int index = lookup(code_point);
+			if (index < 0)
+				index = m_default;
+			if (index >= 0)
+				line += m_glyphs[index].advance;
+		}
+
+		if ((long)width < line)
+			width = line;
+
+		return std::make_tuple(width, lines * height());
+	}
+
+	// the page table already is a direct lookup
+	long BitmapFont::advance(uint32_t code_point) const
+	{
+		int index = lookup(code_point);
+		if (index < 0)
+			index = m_default;
+		return index >= 0 ? m_glyphs[index].advance : 0;
+	}
+
+	ptr bitmap(const void* data, size_t size)
+	{
+		return BitmapFont::load((const uint8_t*)data, size, nullptr);
+	}
+
+	ptr bitmap(const std::string& path)
+	{
+		auto mapping = std::make_shared<Mapping>();
+		if (!mapping->open(path))
+			return nullptr;
+
+		return BitmapFont::load(mapping->data(), mapping->size(), mapping);
+	}
+}} // gfx::font
@@ -0,0 +1,89 @@
+#ifndef __GFX_BITMAP_FONT_HPP__
+#define __GFX_BITMAP_FONT_HPP__
+
+#include <shaker/gfx/font.hpp>
+#include "glyph_cache.hpp"
+#include <memory>
+#include <vector>
+
+namespace gfx
+{
+	namespace font
+	{
+		// BDF and PSF2 fonts read in place from memory.
+		//
+		// Loading only indexes the glyphs: each one is decoded from the file
+		// the first time it is painted and kept in a bounded cache. Code
+		// points are looked up in a two-level table, 256 code points per page,
+		// with pages allocated only where the font has glyphs.
+		class BitmapFont : public Font
+		{
+		public:
+			enum
+			{
+				PAGE_BITS = 8,
+				PAGE_SIZE = 1 << PAGE_BITS,
+				CODE_POINTS = 0x110000,
+				CACHE_BYTES = 256 * 1024
+			};
+
+			// keeps the memory alive, e.g. a file mapping
+			typedef std::shared_ptr<const void> owner_ptr;
+
+			static std::shared_ptr<BitmapFont> load(const uint8_t* data, size_t size, const owner_ptr& owner);
+
+			long height() const override { return m_asc + m_desc; }
+			long asc() const override { return m_asc; }
+			long desc() const override { return m_desc; }
+			long line_height() const override { return m_asc + m_desc; }
+			void paint(const std::string& utf8, int x, int y, uint32_t color, Canvas* canvas) const override;
+			std::tuple<size_t, size_t> textSize(const std::string& utf8) const override;
+			long advance(uint32_t code_point) const override;
+
+			size_t glyphs() const { return m_glyphs.size(); }
+			CacheStats cache_stats() const { return m_decoded.stats(); }
+
+		private:
+			enum Format
+			{
+				BDF,
+				PSF2
+			};
+
+			struct Glyph
+			{
+				uint32_t offset;  // BDF: the first BITMAP row, PSF2: the glyph's bytes
+				int16_t width, height;
+				int16_t x, y;     // top-left corner relative to the pen on the baseline
+				int16_t advance;
+			};
+
+			struct Decoded
+			{
+				std::vector<uint8_t> coverage; // 0 or 255
+				size_t footprint() const { return sizeof(*this) + coverage.capacity(); }
+			};
+
+			BitmapFont(const uint8_t* data, size_t size, const owner_ptr& owner, Format format);
+
+			bool parse_bdf();
+			bool parse_psf2();
+			void map(uint32_t code_point, uint32_t glyph);
+			int lookup(uint32_t code_point) const;
+			std::shared_ptr<Decoded> decode(int glyph) const;
+
+			const uint8_t* m_data;
+			size_t m_size;
+			owner_ptr m_owner;
+			Format m_format;
+			long m_asc, m_desc;
+			int m_default;                     // glyph for unmapped code points, or -1
+			std::vector<Glyph> m_glyphs;
+			std::vector<uint16_t> m_directory; // page + 1 for each run of PAGE_SIZE code points, 0 if empty
+			std::vector<uint32_t> m_pages;     // glyph + 1 for each code point of a page, 0 if none
+			mutable GlyphCache<Decoded> m_decoded;
+		};
+	}
+}
+
+#endif // __GFX_BITMAP_FONT_HPP__
@@ -1,5 +1,5 @@
 #include "builtin_font.hpp"
-#include <shaker/gfx/palette_bitmap.hpp>
+#include <shaker/gfx/alpha_mask.hpp>
 #include <shaker/gfx/utf8.hpp>
 
 namespace gfx { namespace font
@@ -16,20 +16,73 @@ namespace gfx { namespace font
 		static const int glyph_asc = glyph_height - glyph_desc;
 		static const int interline = 2;
 
-		int glyph_id(wchar_t c)
+		// inked part of each glyph cell; x and y are offsets into the cell
+		struct GlyphBounds
 		{
-			for (int i = 0; i < glyphs; ++i)
+			uint8_t x, y, width, height;
+		};
+
+		// Worked out from alphabet and pixmap while the module loads, so
+		// they cannot go stale when a glyph is edited.
+		struct Tables
+		{
+			int8_t ascii_index[128]; // position in alphabet/pixmap, -1 if there is no glyph
+			GlyphBounds bounds[glyphs];
+
+			Tables()
 			{
-				if (alphabet[i] == c)
-					return i;
+				for (int c = 0; c < 128; ++c)
+					ascii_index[c] = -1;
+
+				for (int glyph = 0; glyph < glyphs; ++glyph)
+				{
+					if (alphabet[glyph] < 128)
+						ascii_index[alphabet[glyph]] = (int8_t)glyph;
+
+					const uint8_t* cell = pixmap + glyph * glyph_width * glyph_height;
+					int left = glyph_width, top = glyph_height, right = 0, bottom = 0;
+					for (int y = 0; y < glyph_height; ++y)
+					{
+						for (int x = 0; x < glyph_width; ++x)
+						{
+							if (!cell[x + y * glyph_stride])
+								continue;
+							if (left > x) left = x;
+							if (right < x + 1) right = x + 1;
+							if (top > y) top = y;
+							bottom = y + 1;
+						}
+					}
+
+					GlyphBounds box = { 0, 0, 0, 0 };
+					if (right > left)
+					{
+						box.x = (uint8_t)left;
+						box.y = (uint8_t)top;
+						box.width = (uint8_t)(right - left);
+						box.height = (uint8_t)(bottom - top);
+					}
+					bounds[glyph] = box;
+				}
 			}
-			return -1;
+		};
+
+		static const Tables tables;
+
+		int glyph_id(uint32_t c)
+		{
+			return c < 128 ? tables.ascii_index[c] : -1;
 		}
 
-		void paint(int glyph, int x, int y, const uint32_t* palette, Canvas* canvas)
+		// blits only the inked part of the glyph cell
+		void paint(int glyph, int x, int y, uint32_t color, Canvas* canvas)
 		{
-			const uint8_t* src = pixmap + glyph * glyph_width * glyph_height;
-			canvas->paint(x, y, gfx::PaletteBitmap{ (uint8_t*)src, palette, glyph_width, glyph_height });
+			const GlyphBounds& box = tables.bounds[glyph];
+			if (!box.width)
+				return;
+
+			const uint8_t* src = pixmap + glyph * glyph_width * glyph_height + box.y * glyph_stride + box.x;
+			canvas->fill_mask(x + box.x, y + box.y, gfx::AlphaMask{ src, box.width, box.height, glyph_stride }, color);
 		}
 	}
 
@@ -60,15 +113,11 @@ namespace gfx { namespace font
 
 	void BuiltIn::paint(const std::string& utf8, int x, int y, uint32_t color, Canvas* canvas) const
 	{
-		uint32_t palette[256];
-		color &= 0x00FFFFFF;
-		for (uint32_t alpha = 0; alpha < 0x100; ++alpha)
-			palette[alpha] = color | (alpha << 24);
+		color |= 0xFF000000;
 
 		auto cr = x;
 
-		auto text = utf8::to32(utf8);
-		for (auto&& c : text)
+		for (auto c : utf8::view(utf8))
 		{
 			if (c == ' ')
 			{
@@ -83,7 +132,7 @@ namespace gfx { namespace font
 			}
 			auto glyph = glyph_id(c);
 			if (glyph < 0) continue;
-			font::paint(glyph, x, y, palette, canvas);
+			font::paint(glyph, x, y, color, canvas);
 			x += glyph_width;
 		}
 	}
@@ -94,8 +143,7 @@ namespace gfx { namespace font
 		size_t height = 1;
 		size_t line = 0;
 
-		auto text = utf8::to32(utf8);
-		for (auto&& c : text)
+		for (auto c : utf8::view(utf8))
 		{
 			if (c == '\n')
 			{
@@ -122,4 +170,10 @@ namespace gfx { namespace font
 			height * glyph_height + (height - 1) * interline
 			);
 	}
+
+	// monospaced: every code point with a glyph, and the space, is one cell
+	long BuiltIn::advance(uint32_t code_point) const
+	{
+		return code_point == ' ' || glyph_id(code_point) >= 0 ? glyph_width : 0;
+	}
 }} // gfx::font
@@ -16,6 +16,7 @@ namespace gfx
 			long line_height() const override;
 			void paint(const std::string& utf8, int x, int y, uint32_t color, Canvas* canvas) const override;
 			std::tuple<size_t, size_t> textSize(const std::string& utf8) const override;
+			long advance(uint32_t code_point) const override;
 		};
 	}
 }
@@ -3,10 +3,178 @@
 #include <shaker/gfx/bitmap.hpp>
 #include <shaker/gfx/alpha_bitmap.hpp>
 #include <shaker/gfx/palette_bitmap.hpp>
+#include <shaker/gfx/alpha_mask.hpp>
+#include "simd.hpp"
+#include <math.h>
 #include <utility>
 
 namespace gfx
 {
+	namespace
+	{
+		// x / 255 for x in [0, 255 * 255]
+		inline int div255(int x)
+		{
+			return (x + 1 + (x >> 8)) >> 8;
+		}
+
+#if GFX_SSE2
+		inline __m128i div255(__m128i x)
+		{
+			x = _mm_add_epi16(x, _mm_add_epi16(_mm_set1_epi16(1), _mm_srli_epi16(x, 8)));
+			return _mm_srli_epi16(x, 8);
+		}
+
+		// (over * a + under * (255 - a)) / 255 on 16-bit lanes
+		inline __m128i blend16(__m128i over, __m128i under, __m128i a)
+		{
+			__m128i inv = _mm_sub_epi16(_mm_set1_epi16(255), a);
+			return div255(_mm_add_epi16(_mm_mullo_epi16(over, a), _mm_mullo_epi16(under, inv)));
+		}
+#endif
+
+		inline uint32_t blend_pixel(uint32_t over, uint32_t under, int a)
+		{
+			uint32_t out = 0xFF000000;
+			for (int shift = 0; shift < 24; shift += 8)
+			{
+				int c = (over >> shift) & 0xFF;
+				int d = (under >> shift) & 0xFF;
+				out |= (uint32_t)div255(c * a + d * (255 - a)) << shift;
+			}
+			return out;
+		}
+
+		void fill_row(const uint8_t* coverage, uint32_t* dst, int width, uint32_t solid, int alpha)
+		{
+			int x = 0;
+#if GFX_SSE2
+			__m128i zero = _mm_setzero_si128();
+			__m128i over = _mm_unpacklo_epi8(_mm_set1_epi32((int)solid), zero);
+			__m128i scale = _mm_set1_epi16((short)alpha);
+			__m128i opaque = _mm_set1_epi32((int)0xFF000000);
+
+			for (; x + 4 <= width; x += 4)
+			{
+				uint32_t four = simd::load32(coverage + x);
+				if (!four)
+					continue;
+
+				__m128i* out = (__m128i*)(dst + x);
+				if (four == 0xFFFFFFFF && alpha == 255)
+				{
+					_mm_storeu_si128(out, _mm_set1_epi32((int)solid));
+					continue;
+				}
+
+				__m128i a = _mm_unpacklo_epi8(_mm_cvtsi32_si128((int)four), zero);
+				if (alpha != 255)
+					a = div255(_mm_mullo_epi16(a, scale));
+
+				// pixels with no coverage keep their alpha, like the scalar path
+				__m128i covered = _mm_andnot_si128(_mm_cmpeq_epi32(_mm_unpacklo_epi16(a, zero), zero), opaque);
+
+				// one coverage value per pixel, spread over its four channels
+				a = _mm_unpacklo_epi16(a, a);
+				__m128i a_lo = _mm_unpacklo_epi32(a, a);
+				__m128i a_hi = _mm_unpackhi_epi32(a, a);
+
+				__m128i under = simd::load16(out);
+				__m128i lo = blend16(over, _mm_unpacklo_epi8(under, zero), a_lo);
+				__m128i hi = blend16(over, _mm_unpackhi_epi8(under, zero), a_hi);
+				_mm_storeu_si128(out, _mm_or_si128(_mm_packus_epi16(lo, hi), covered));
+			}
+#endif
+			for (; x < width; ++x)
+			{
+				int a = coverage[x];
+				if (alpha != 255)
+					a = div255(a * alpha);
+
+				if (!a)
+					continue;
+
+				dst[x] = a == 255 ? solid : blend_pixel(solid, dst[x], a);
+			}
+		}
+	}
+
+	namespace
+	{
+		// where each canvas column samples the field: two columns and the
+		// weight of the second
+		struct Taps
+		{
+			enum { COUNT = 64 };
+			int first[COUNT], second[COUNT];
+			float weight[COUNT];
+		};
+
+		inline void tap(float u, int size, int& first, int& second, float& weight)
+		{
+			float f = floorf(u);
+			weight = u - f;
+			first = (int)f;
+			second = first + 1;
+			if (first < 0) first = 0;
+			if (first >= size) first = size - 1;
+			if (second < 0) second = 0;
+			if (second >= size) second = size - 1;
+		}
+
+		// bilinear samples of two field rows, then smoothstep(lo, lo + 1 / inv)
+		void field_row(const uint8_t* top, const uint8_t* bottom, float fy, const Taps& taps, int width,
+			float lo, float inv, uint8_t* coverage)
+		{
+			int x = 0;
+#if GFX_SSE2
+			__m128 wy = _mm_set1_ps(fy);
+			__m128 low = _mm_set1_ps(lo);
+			__m128 scale = _mm_set1_ps(inv);
+			__m128 zero = _mm_setzero_ps();
+			__m128 one = _mm_set1_ps(1.0f);
+			__m128 three = _mm_set1_ps(3.0f);
+			__m128 two = _mm_set1_ps(2.0f);
+			__m128 full = _mm_set1_ps(255.0f);
+			__m128 half = _mm_set1_ps(0.5f);
+
+			for (; x + 4 <= width; x += 4)
+			{
+				const int* a = taps.first + x;
+				const int* b = taps.second + x;
+				__m128 tl = _mm_setr_ps(top[a[0]], top[a[1]], top[a[2]], top[a[3]]);
+				__m128 tr = _mm_setr_ps(top[b[0]], top[b[1]], top[b[2]], top[b[3]]);
+				__m128 bl = _mm_setr_ps(bottom[a[0]], bottom[a[1]], bottom[a[2]], bottom[a[3]]);
+				__m128 br = _mm_setr_ps(bottom[b[0]], bottom[b[1]], bottom[b[2]], bottom[b[3]]);
+				__m128 wx = _mm_loadu_ps(taps.weight + x);
+
+				__m128 upper = _mm_add_ps(tl, _mm_mul_ps(_mm_sub_ps(tr, tl), wx));
+				__m128 lower = _mm_add_ps(bl, _mm_mul_ps(_mm_sub_ps(br, bl), wx));
+				__m128 value = _mm_add_ps(upper, _mm_mul_ps(_mm_sub_ps(lower, upper), wy));
+
+				__m128 t = _mm_mul_ps(_mm_sub_ps(value, low), scale);
+				t = _mm_min_ps(_mm_max_ps(t, zero), one);
+				__m128 step = _mm_mul_ps(_mm_mul_ps(t, t), _mm_sub_ps(three, _mm_mul_ps(two, t)));
+
+				__m128i c = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(step, full), half));
+				c = _mm_packs_epi32(c, c);
+				*(int*)(coverage + x) = _mm_cvtsi128_si32(_mm_packus_epi16(c, c));
+			}
+#endif
+			for (; x < width; ++x)
+			{
+				float wx = taps.weight[x];
+				float upper = top[taps.first[x]] + (top[taps.second[x]] - top[taps.first[x]]) * wx;
+				float lower = bottom[taps.first[x]] + (bottom[taps.second[x]] - bottom[taps.first[x]]) * wx;
+				float value = upper + (lower - upper) * fy;
+
+				float t = (value - lo) * inv;
+				t = t < 0 ? 0 : t > 1 ? 1 : t;
+				coverage[x] = (uint8_t)(t * t * (3 - 2 * t) * 255.0f + 0.5f);
+			}
+		}
+	}
+
 	Canvas::Canvas(uint32_t* data, int width, int height, int stride)
 		: m_data(data)
 		, m_width(width)
@@ -321,4 +489,73 @@ namespace gfx
 				[blend](const uint8_t*& src, uint32_t*& dst){ blend(src, dst)++; });
 		}
 	}
-}
\ No newline at end of file
+
+	void Canvas::fill_mask(int x, int y, const AlphaMask& mask, uint32_t color)
+	{
+		int alpha = (color >> 24) & 0xFF;
+		if (!alpha)
+			return;
+
+		int w = mask.width();
+		int h = mask.height();
+		int offset_x, offset_y;
+
+		if (!update_pos(x, y, w, h, offset_x, offset_y))
+			return;
+
+		uint32_t solid = RGB24((color >> 16) & 0xFF, (color >> 8) & 0xFF, color & 0xFF);
+		const uint8_t* source = mask.m_data + offset_x + offset_y * mask.m_stride;
+		uint32_t* dest = m_data + x + y * m_stride;
+
+		for (int row = 0; row < h; ++row)
+			fill_row(source + row * mask.m_stride, dest + row * m_stride, w, solid, alpha);
+	}
+
+	void Canvas::fill_field(float x, float y, float scale, const AlphaMask& field, float spread, uint32_t color)
+	{
+		int alpha = (color >> 24) & 0xFF;
+		int fw = field.width();
+		int fh = field.height();
+		if (!alpha || scale <= 0 || spread <= 0 || !fw || !fh)
+			return;
+
+		int left = (int)floorf(x);
+		int top = (int)floorf(y);
+		int right = (int)ceilf(x + fw * scale);
+		int bottom = (int)ceilf(y + fh * scale);
+		if (left < 0) left = 0;
+		if (top < 0) top = 0;
+		if (right > m_width) right = m_width;
+		if (bottom > m_height) bottom = m_height;
+		if (left >= right || top >= bottom)
+			return;
+
+		// one canvas pixel across the outline
+		float ramp = 127.0f / (spread * scale);
+		float lo = 128.0f - 0.5f * ramp;
+		float inv = 1.0f / ramp;
+
+		uint32_t solid = RGB24((color >> 16) & 0xFF, (color >> 8) & 0xFF, color & 0xFF);
+		const uint8_t* data = field.data();
+		int stride = field.stride();
+
+		Taps taps;
+		uint8_t coverage[Taps::COUNT];
+		for (int begin = left; begin < right; begin += Taps::COUNT)
+		{
+			int width = right - begin < Taps::COUNT ? right - begin : Taps::COUNT;
+			for (int i = 0; i < width; ++i)
+				tap((begin + i + 0.5f - x) / scale - 0.5f, fw, taps.first[i], taps.second[i], taps.weight[i]);
+
+			for (int row = top; row < bottom; ++row)
+			{
+				int first, second;
+				float fy;
+				tap((row + 0.5f - y) / scale - 0.5f, fh, first, second, fy);
+
+				field_row(data + first * stride, data + second * stride, fy, taps, width, lo, inv, coverage);
+				fill_row(coverage, m_data + begin + row * m_stride, width, solid, alpha);
+			}
+		}
+	}
+}
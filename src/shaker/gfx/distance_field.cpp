@@ -0,0 +1,106 @@
+#include "distance_field.hpp"
+#include <math.h>
+#include <vector>
+
+namespace gfx { namespace font
+{
+	namespace
+	{
+		static const float FAR = 1e20f;
+
+		// Felzenszwalb and Huttenlocher: squared distances along a line,
+		// as the lower envelope of the parabolas rooted at each sample
+		struct Envelope
+		{
+			std::vector<float> f, z;
+			std::vector<int> v;
+
+			explicit Envelope(int size) : f(size), z(size + 1), v(size) {}
+
+			// where the parabolas of q and an earlier p cross
+			float meet(int q, int p) const
+			{
+				return ((f[q] + (float)q * q) - (f[p] + (float)p * p)) / (2.0f * (q - p));
+			}
+
+			void transform(float* line, int count, int step)
+			{
+				for (int i = 0; i < count; ++i)
+					f[i] = line[i * step];
+
+				int k = 0;
+				v[0] = 0;
+				z[0] = -FAR;
+				z[1] = FAR;
+				for (int q = 1; q < count; ++q)
+				{
+					float s = meet(q, v[k]);
+					while (s <= z[k])
+						s = meet(q, v[--k]);
+					++k;
+					v[k] = q;
+					z[k] = s;
+					z[k + 1] = FAR;
+				}
+
+				k = 0;
+				for (int q = 0; q < count; ++q)
+				{
+					while (z[k + 1] < q)
+						++k;
+					float d = (float)(q - v[k]);
+					line[q * step] = d * d + f[v[k]];
+				}
+			}
+		};
+
+		void transform(std::vector<float>& grid, int width, int height)
+		{
+			Envelope envelope(width > height ? width : height);
+			for (int x = 0; x < width; ++x)
+				envelope.transform(grid.data() + x, height, width);
+			for (int y = 0; y < height; ++y)
+				envelope.transform(grid.data() + y * width, width, 1);
+		}
+	}
+
+	void distance_field(const uint8_t* coverage, int width, int height, int stride, int spread, uint8_t* out, int out_stride)
+	{
+		if (width <= 0 || height <= 0)
+			return;
+
+		// squared distances to the nearest pixel inside, and outside
+		std::vector<float> to_inside(width * height), to_outside(width * height);
+		for (int y = 0; y < height; ++y)
+		{
+			for (int x = 0; x < width; ++x)
+			{
+				bool inside = coverage[x + y * stride] >= 128;
+				to_inside[x + y * width] = inside ? 0 : FAR;
+				to_outside[x + y * width] = inside ? FAR : 0;
+			}
+		}
+
+		transform(to_inside, width, height);
+		transform(to_outside, width, height);
+
+		float unit = 127.0f / spread;
+		for (int y = 0; y < height; ++y)
+		{
+			for (int x = 0; x < width; ++x)
+			{
+				int c = coverage[x + y * stride];
+				float d;
+				if (c > 0 && c < 255)
+					d = (c - 127.5f) / 255.0f;
+				else if (c >= 128)
+					d = sqrtf(to_outside[x + y * width]) - 0.5f;
+				else
+					d = 0.5f - sqrtf(to_inside[x + y * width]);
+
+				float value = 128.0f + d * unit;
+				out[x + y * out_stride] = value <= 0 ? 0 : value >= 255 ? 255 : (uint8_t)(value + 0.5f);
+			}
+		}
+	}
+}} // gfx::font
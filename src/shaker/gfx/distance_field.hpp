@@ -0,0 +1,19 @@
+#ifndef __GFX_DISTANCE_FIELD_HPP__
+#define __GFX_DISTANCE_FIELD_HPP__
+
+#include <stdint.h>
+
+namespace gfx
+{
+	namespace font
+	{
+		// Turns width x height coverage into a signed distance field of the
+		// same size: 128 on the outline, 255 spread pixels or more inside,
+		// 0 as far outside. Pixels the outline crosses use their coverage,
+		// the others the exact Euclidean distance to the nearest pixel on
+		// the other side.
+		void distance_field(const uint8_t* coverage, int width, int height, int stride, int spread, uint8_t* out, int out_stride);
+	}
+}
+
+#endif // __GFX_DISTANCE_FIELD_HPP__
@@ -0,0 +1,60 @@
+#include <shaker/gfx/font.hpp>
+#include <shaker/gfx/utf8.hpp>
+#include <algorithm>
+
+namespace gfx { namespace font
+{
+	size_t Font::measure(const std::string& utf8, long max_width, size_t* break_pos) const
+	{
+		long width = 0;
+		long line = 0;
+
+		utf8::view text(utf8);
+		for (auto cur = text.begin(), end = text.end(); cur != end; ++cur)
+		{
+			if (*cur == '\n')
+			{
+				if (width < line)
+					width = line;
+				line = 0;
+				continue;
+			}
+
+			long advance = this->advance(*cur);
+			if (max_width >= 0 && line + advance > max_width)
+			{
+				if (break_pos)
+					*break_pos = cur.position() - utf8.data();
+				return width < line ? line : width;
+			}
+			line += advance;
+		}
+
+		if (break_pos)
+			*break_pos = utf8.size();
+		return width < line ? line : width;
+	}
+
+	// a glyph may reach about a line height past its pen, hence the margins
+	bool Font::culled(const TextItem& item, const Canvas& canvas) const
+	{
+		long margin = line_height();
+		if (item.y >= canvas.height() || item.x - margin >= canvas.width())
+			return true;
+
+		long lines = 1 + std::count(item.utf8->begin(), item.utf8->end(), '\n');
+		if (item.y + lines * margin <= 0)
+			return true;
+
+		return item.x < 0 && item.x + (long)measure(*item.utf8) + margin <= 0;
+	}
+
+	void Font::paint_batch(const TextItem* items, size_t count, Canvas* canvas) const
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (!culled(items[i], *canvas))
+				paint(*items[i].utf8, items[i].x, items[i].y, items[i].color, canvas);
+		}
+	}
+}} // gfx::font
@@ -0,0 +1,179 @@
+#include "glyph_atlas.hpp"
+#include <algorithm>
+#include <string.h>
+
+namespace gfx { namespace font
+{
+	GlyphAtlas::Page::Page(int size)
+		: pixels((size_t)size * size)
+		, size(size)
+		, bottom(0)
+		, used(0)
+		, live(0)
+	{
+	}
+
+	GlyphAtlas::GlyphAtlas(int page_size, size_t max_pages)
+		: m_page_size(page_size)
+		, m_max_pages(max_pages ? max_pages : 1)
+		, m_evicted_flag(false)
+	{
+	}
+
+	// best fitting shelf, or a new one under the last
+	bool GlyphAtlas::place(Page& page, int width, int height, Region& out) const
+	{
+		Page::Shelf* best = nullptr;
+		for (auto&& shelf : page.shelves)
+		{
+			// do not waste more than about a third of a shelf's height
+			if (shelf.height < height || shelf.height > height + height / 2 + 1)
+				continue;
+			if (page.size - shelf.x < width)
+				continue;
+			if (!best || shelf.height < best->height)
+				best = &shelf;
+		}
+
+		if (!best)
+		{
+			if (page.size - page.bottom < height || page.size < width)
+				return false;
+
+			Page::Shelf shelf = { page.bottom, height, 0 };
+			page.shelves.push_back(shelf);
+			page.bottom += height;
+			best = &page.shelves.back();
+		}
+
+		out.x = best->x;
+		out.y = best->y;
+		out.width = width;
+		out.height = height;
+		best->x += width;
+
+		size_t area = (size_t)width * height;
+		page.used += area;
+		page.live.fetch_add(area);
+		return true;
+	}
+
+	void GlyphAtlas::reset(Page& page) const
+	{
+		page.shelves.clear();
+		page.bottom = 0;
+		page.used = 0;
+		memset(page.pixels.data(), 0, page.pixels.size());
+	}
+
+	GlyphAtlas::Region GlyphAtlas::allocate(int width, int height)
+	{
+		Region out;
+		if (width <= 0 || height <= 0)
+			return out;
+
+		// larger than a page: a page of its own, freed with the glyph
+		if (width > m_page_size || height > m_page_size)
+		{
+			out.page = std::make_shared<Page>(std::max(width, height));
+			place(*out.page, width, height, out);
+			return out;
+		}
+
+		std::lock_guard<std::mutex> lock(m);
+
+		for (auto&& page : m_pages)
+		{
+			if (place(*page, width, height, out))
+			{
+				out.page = page;
+				return out;
+			}
+		}
+
+		// every glyph of this page is gone
+		for (auto&& page : m_pages)
+		{
+			if (page->used && !page->live.load())
+			{
+				reset(*page);
+				if (place(*page, width, height, out))
+				{
+					out.page = page;
+					return out;
+				}
+			}
+		}
+
+		if (m_pages.size() < m_max_pages)
+		{
+			m_pages.push_back(std::make_shared<Page>(m_page_size));
+		}
+		else
+		{
+			auto victim = std::min_element(m_pages.begin(), m_pages.end(), [](const page_ptr& lhs, const page_ptr& rhs)
+			{
+				return lhs->live.load() < rhs->live.load();
+			});
+
+			m_evicted.push_back(*victim);
+			m_evicted_flag.store(true, std::memory_order_relaxed);
+
+			// the old page stays alive until the glyphs on it are dropped
+			std::rotate(victim, victim + 1, m_pages.end());
+			m_pages.back() = std::make_shared<Page>(m_page_size);
+		}
+
+		out.page = m_pages.back();
+		place(*out.page, width, height, out);
+		return out;
+	}
+
+	void GlyphAtlas::release(const Region& region)
+	{
+		if (region.page)
+			region.page->live.fetch_sub(region.area());
+	}
+
+	std::vector<GlyphAtlas::page_ptr> GlyphAtlas::take_evicted()
+	{
+		std::lock_guard<std::mutex> lock(m);
+		std::vector<page_ptr> out;
+		out.swap(m_evicted);
+		m_evicted_flag.store(false, std::memory_order_relaxed);
+		return out;
+	}
+
+	std::vector<GlyphAtlas::page_ptr> GlyphAtlas::defragment()
+	{
+		std::lock_guard<std::mutex> lock(m);
+
+		std::vector<page_ptr> retired;
+		size_t half = (size_t)m_page_size * m_page_size / 2;
+		auto sparse = [&](const page_ptr& page)
+		{
+			return page->used > half && page->live.load() * 2 < page->used;
+		};
+
+		for (auto&& page : m_pages)
+		{
+			if (sparse(page))
+				retired.push_back(page);
+		}
+
+		m_pages.erase(std::remove_if(m_pages.begin(), m_pages.end(), sparse), m_pages.end());
+		return retired;
+	}
+
+	size_t GlyphAtlas::pages() const
+	{
+		std::lock_guard<std::mutex> lock(m);
+		return m_pages.size();
+	}
+
+	size_t GlyphAtlas::bytes() const
+	{
+		std::lock_guard<std::mutex> lock(m);
+		return m_pages.size() * m_page_size * m_page_size;
+	}
+}} // gfx::font
@@ -0,0 +1,91 @@
+#ifndef __GFX_GLYPH_ATLAS_HPP__
+#define __GFX_GLYPH_ATLAS_HPP__
+
+#include <shaker/gfx/alpha_mask.hpp>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace gfx
+{
+	namespace font
+	{
+		// Square A8 pages holding many glyphs each, filled by a shelf packer.
+		//
+		// A region keeps its page alive, so glyphs stay paintable after the
+		// page has been evicted or retired; the owner of the glyphs is told
+		// about such pages (take_evicted(), defragment()) and drops or moves
+		// the glyphs living there. Regions are never written after they have
+		// been filled, so painting needs no lock.
+		class GlyphAtlas
+		{
+		public:
+			struct Page
+			{
+				struct Shelf
+				{
+					int y, height, x; // x is where the next region goes
+				};
+
+				std::vector<uint8_t> pixels;
+				int size;
+				std::vector<Shelf> shelves;
+				int bottom;                 // top of the unshelved space
+				size_t used;                // pixels handed out since the last reset
+				std::atomic<size_t> live;   // pixels of regions still alive
+
+				explicit Page(int size);
+			};
+			typedef std::shared_ptr<Page> page_ptr;
+
+			struct Region
+			{
+				page_ptr page;
+				int x, y, width, height;
+
+				Region() : x(0), y(0), width(0), height(0) {}
+
+				uint8_t* data() const { return page->pixels.data() + x + y * page->size; }
+				int stride() const { return page->size; }
+				AlphaMask mask() const { return AlphaMask(data(), width, height, stride()); }
+				size_t area() const { return (size_t)width * height; }
+			};
+
+			GlyphAtlas(int page_size, size_t max_pages);
+
+			// a zero-filled region; evicts the emptiest page when all are full
+			Region allocate(int width, int height);
+
+			// called when the region's glyph goes away
+			static void release(const Region& region);
+
+			// pages dropped by allocate() since the last call
+			bool evicted() const { return m_evicted_flag.load(std::memory_order_relaxed); }
+			std::vector<page_ptr> take_evicted();
+
+			// retires pages where less than half of the handed out space is
+			// still alive; their glyphs should be copied into new regions
+			std::vector<page_ptr> defragment();
+
+			size_t pages() const;
+			size_t bytes() const;
+
+		private:
+			GlyphAtlas(const GlyphAtlas&);
+			GlyphAtlas& operator=(const GlyphAtlas&);
+
+			bool place(Page& page, int width, int height, Region& out) const;
+			void reset(Page& page) const;
+
+			mutable std::mutex m;
+			int m_page_size;
+			size_t m_max_pages;
+			std::vector<page_ptr> m_pages;
+			std::vector<page_ptr> m_evicted;
+			std::atomic<bool> m_evicted_flag;
+		};
+	}
+}
+
+#endif // __GFX_GLYPH_ATLAS_HPP__
@@ -0,0 +1,302 @@
+#ifndef __GFX_GLYPH_CACHE_HPP__
+#define __GFX_GLYPH_CACHE_HPP__
+
+#include <shaker/gfx/font.hpp>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace gfx
+{
+	namespace font
+	{
+		// Open-addressing cache keyed by glyph id, bounded both in bytes and
+		// in entries, with CLOCK eviction.
+		//
+		// find() does not lock. Slots are shared_ptrs read with atomic_load, so
+		// a writer replacing a slot never frees an entry under a reader. A
+		// lookup racing with a rebuild of the table may miss; get() looks
+		// again under the lock before creating anything. T reports its size
+		// in bytes with footprint().
+		template <typename T>
+		class GlyphCache
+		{
+		public:
+			typedef std::shared_ptr<T> value_ptr;
+
+			explicit GlyphCache(size_t limit, size_t slots = 4096);
+
+			value_ptr find(uint32_t id) const;
+
+			// find(), or make() the value under the lock and keep it
+			template <typename Make>
+			value_ptr get(uint32_t id, Make make);
+
+			// replaces every value with fn(value) under the lock; a null
+			// result drops the entry
+			template <typename Fn>
+			void update(Fn fn);
+
+			void limit(size_t bytes);
+			void clear();
+			CacheStats stats() const;
+			// entries kept at most, whatever their size
+			size_t max_entries() const { return (m_mask + 1) / 2; }
+
+		private:
+			struct Entry
+			{
+				uint32_t id;
+				value_ptr value;
+				size_t bytes;
+				mutable std::atomic<bool> referenced;
+
+				Entry(uint32_t id, const value_ptr& value, size_t bytes)
+					: id(id)
+					, value(value)
+					, bytes(bytes)
+					, referenced(false)
+				{
+				}
+			};
+			typedef std::shared_ptr<Entry> entry_ptr;
+
+			GlyphCache(const GlyphCache&);
+			GlyphCache& operator=(const GlyphCache&);
+
+			size_t home(uint32_t id) const { return (id * 2654435761u) & m_mask; }
+			entry_ptr lookup(uint32_t id) const;
+			value_ptr hit(const entry_ptr& entry) const;
+			void insert(const entry_ptr& entry);
+			void evict();
+			void rebuild();
+
+			mutable std::mutex m;
+			std::vector<entry_ptr> m_slots;
+			size_t m_mask;
+			entry_ptr m_tombstone;   // an evicted slot; lookups probe past it
+			size_t m_limit;
+			size_t m_bytes;
+			size_t m_entries;
+			size_t m_used;           // live entries and tombstones
+			size_t m_hand;           // CLOCK position
+			mutable std::atomic<uint64_t> m_hits;
+			std::atomic<uint64_t> m_misses;
+			std::atomic<uint64_t> m_evictions;
+		};
+
+		template <typename T>
+		GlyphCache<T>::GlyphCache(size_t limit, size_t slots)
+			: m_mask(0)
+			, m_tombstone(std::make_shared<Entry>(0, value_ptr(), 0))
+			, m_limit(limit)
+			, m_bytes(0)
+			, m_entries(0)
+			, m_used(0)
+			, m_hand(0)
+			, m_hits(0)
+			, m_misses(0)
+			, m_evictions(0)
+		{
+			size_t size = 16;
+			while (size < slots)
+				size <<= 1;
+
+			m_slots.resize(size);
+			m_mask = size - 1;
+		}
+
+		template <typename T>
+		typename GlyphCache<T>::entry_ptr GlyphCache<T>::lookup(uint32_t id) const
+		{
+			size_t slot = home(id);
+			for (size_t probe = 0; probe <= m_mask; ++probe, slot = (slot + 1) & m_mask)
+			{
+				entry_ptr entry = std::atomic_load(&m_slots[slot]);
+				if (!entry)
+					return nullptr;
+				if (entry != m_tombstone && entry->id == id)
+					return entry;
+			}
+			return nullptr;
+		}
+
+		template <typename T>
+		typename GlyphCache<T>::value_ptr GlyphCache<T>::hit(const entry_ptr& entry) const
+		{
+			// a plain load first, so hot entries do not keep dirtying their cache line
+			if (!entry->referenced.load(std::memory_order_relaxed))
+				entry->referenced.store(true, std::memory_order_relaxed);
+			m_hits.fetch_add(1, std::memory_order_relaxed);
+			return entry->value;
+		}
+
+		template <typename T>
+		typename GlyphCache<T>::value_ptr GlyphCache<T>::find(uint32_t id) const
+		{
+			auto entry = lookup(id);
+			return entry ? hit(entry) : nullptr;
+		}
+
+		template <typename T>
+		template <typename Make>
+		typename GlyphCache<T>::value_ptr GlyphCache<T>::get(uint32_t id, Make make)
+		{
+			auto entry = lookup(id);
+			if (entry)
+				return hit(entry);
+
+			std::lock_guard<std::mutex> lock(m);
+
+			entry = lookup(id);
+			if (entry)
+				return hit(entry);
+
+			m_misses.fetch_add(1, std::memory_order_relaxed);
+
+			value_ptr value = make();
+			if (!value)
+				return value;
+
+			size_t bytes = value->footprint();
+			while (m_entries && (m_bytes + bytes > m_limit || m_entries >= max_entries()))
+				evict();
+
+			// keep at least a quarter of the slots empty, so probe chains stay short
+			if (m_used >= (m_mask + 1) * 3 / 4)
+				rebuild();
+
+			insert(std::make_shared<Entry>(id, value, bytes));
+			return value;
+		}
+
+		template <typename T>
+		void GlyphCache<T>::insert(const entry_ptr& entry)
+		{
+			size_t slot = home(entry->id);
+			for (;; slot = (slot + 1) & m_mask)
+			{
+				auto& current = m_slots[slot];
+				if (!current)
+				{
+					++m_used;
+					break;
+				}
+				if (current == m_tombstone)
+					break;
+			}
+
+			std::atomic_store(&m_slots[slot], entry);
+			m_bytes += entry->bytes;
+			++m_entries;
+		}
+
+		// drops one entry not referenced since the hand last passed it
+		template <typename T>
+		void GlyphCache<T>::evict()
+		{
+			for (;;)
+			{
+				auto& slot = m_slots[m_hand];
+				m_hand = (m_hand + 1) & m_mask;
+
+				if (!slot || slot == m_tombstone)
+					continue;
+
+				if (slot->referenced.exchange(false, std::memory_order_relaxed))
+					continue;
+
+				m_bytes -= slot->bytes;
+				--m_entries;
+				m_evictions.fetch_add(1, std::memory_order_relaxed);
+				std::atomic_store(&slot, m_tombstone);
+				return;
+			}
+		}
+
+		// reinserts the live entries, dropping the tombstones
+		template <typename T>
+		void GlyphCache<T>::rebuild()
+		{
+			std::vector<entry_ptr> live;
+			live.reserve(m_entries);
+			for (auto&& slot : m_slots)
+			{
+				if (slot && slot != m_tombstone)
+					live.push_back(slot);
+				std::atomic_store(&slot, entry_ptr());
+			}
+
+			m_bytes = m_entries = m_used = 0;
+			for (auto&& entry : live)
+				insert(entry);
+		}
+
+		template <typename T>
+		template <typename Fn>
+		void GlyphCache<T>::update(Fn fn)
+		{
+			std::lock_guard<std::mutex> lock(m);
+			for (auto&& slot : m_slots)
+			{
+				if (!slot || slot == m_tombstone)
+					continue;
+
+				entry_ptr entry = slot;
+				value_ptr value = fn(entry->value);
+				if (value == entry->value)
+					continue;
+
+				m_bytes -= entry->bytes;
+				--m_entries;
+
+				if (!value)
+				{
+					std::atomic_store(&slot, m_tombstone);
+					continue;
+				}
+
+				size_t bytes = value->footprint();
+				std::atomic_store(&slot, std::make_shared<Entry>(entry->id, value, bytes));
+				m_bytes += bytes;
+				++m_entries;
+			}
+		}
+
+		template <typename T>
+		void GlyphCache<T>::limit(size_t bytes)
+		{
+			std::lock_guard<std::mutex> lock(m);
+			m_limit = bytes;
+			while (m_entries && m_bytes > m_limit)
+				evict();
+		}
+
+		template <typename T>
+		void GlyphCache<T>::clear()
+		{
+			std::lock_guard<std::mutex> lock(m);
+			for (auto&& slot : m_slots)
+				std::atomic_store(&slot, entry_ptr());
+			m_bytes = m_entries = m_used = 0;
+		}
+
+		template <typename T>
+		CacheStats GlyphCache<T>::stats() const
+		{
+			std::lock_guard<std::mutex> lock(m);
+			CacheStats out = {
+				m_hits.load(std::memory_order_relaxed),
+				m_misses.load(std::memory_order_relaxed),
+				m_evictions.load(std::memory_order_relaxed),
+				m_entries,
+				m_bytes,
+				m_limit
+			};
+			return out;
+		}
+	}
+}
+
+#endif // __GFX_GLYPH_CACHE_HPP__
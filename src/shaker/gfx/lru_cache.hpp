@@ -0,0 +1,175 @@
+#ifndef __GFX_LRU_CACHE_HPP__
+#define __GFX_LRU_CACHE_HPP__
+
+#include <shaker/gfx/font.hpp>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace gfx
+{
+	namespace font
+	{
+		// String-keyed cache of immutable values, bounded in bytes, dropping
+		// the least recently used entries first. Entries are found by the
+		// hash of the key and confirmed with a full compare.
+		template <typename T>
+		class LruCache
+		{
+		public:
+			typedef std::shared_ptr<const T> value_ptr;
+
+			explicit LruCache(size_t limit);
+
+			value_ptr find(const std::string& key);
+
+			// bytes is the size of the value; the key and bookkeeping are added to it
+			void insert(const std::string& key, const value_ptr& value, size_t bytes);
+
+			void limit(size_t bytes);
+			void clear();
+			CacheStats stats() const;
+
+		private:
+			struct Entry
+			{
+				std::string key;
+				size_t hash;
+				value_ptr value;
+				size_t bytes;
+			};
+			typedef std::list<Entry> entries;
+			typedef std::unordered_multimap<size_t, typename entries::iterator> index;
+
+			LruCache(const LruCache&);
+			LruCache& operator=(const LruCache&);
+
+			typename entries::iterator lookup(const std::string& key, size_t hash);
+			void trim(size_t limit);
+
+			mutable std::mutex m;
+			entries m_entries;   // most recently used first
+			index m_index;
+			size_t m_limit;
+			size_t m_bytes;
+			uint64_t m_hits;
+			uint64_t m_misses;
+			uint64_t m_evictions;
+		};
+
+		template <typename T>
+		LruCache<T>::LruCache(size_t limit)
+			: m_limit(limit)
+			, m_bytes(0)
+			, m_hits(0)
+			, m_misses(0)
+			, m_evictions(0)
+		{
+		}
+
+		template <typename T>
+		typename LruCache<T>::entries::iterator LruCache<T>::lookup(const std::string& key, size_t hash)
+		{
+			auto range = m_index.equal_range(hash);
+			for (auto it = range.first; it != range.second; ++it)
+			{
+				if (it->second->key == key)
+					return it->second;
+			}
+			return m_entries.end();
+		}
+
+		template <typename T>
+		typename LruCache<T>::value_ptr LruCache<T>::find(const std::string& key)
+		{
+			size_t hash = std::hash<std::string>()(key);
+
+			std::lock_guard<std::mutex> lock(m);
+			auto it = lookup(key, hash);
+			if (it == m_entries.end())
+			{
+				++m_misses;
+				return nullptr;
+			}
+
+			++m_hits;
+			m_entries.splice(m_entries.begin(), m_entries, it);
+			return it->value;
+		}
+
+		template <typename T>
+		void LruCache<T>::insert(const std::string& key, const value_ptr& value, size_t bytes)
+		{
+			size_t hash = std::hash<std::string>()(key);
+			bytes += sizeof(Entry) + key.size();
+
+			std::lock_guard<std::mutex> lock(m);
+
+			// another thread got here first
+			if (lookup(key, hash) != m_entries.end())
+				return;
+
+			if (bytes > m_limit)
+				return;
+
+			trim(m_limit - bytes);
+
+			Entry entry = { key, hash, value, bytes };
+			m_entries.push_front(entry);
+			m_index.insert(std::make_pair(hash, m_entries.begin()));
+			m_bytes += bytes;
+		}
+
+		template <typename T>
+		void LruCache<T>::trim(size_t limit)
+		{
+			while (m_bytes > limit && !m_entries.empty())
+			{
+				auto last = std::prev(m_entries.end());
+				auto range = m_index.equal_range(last->hash);
+				for (auto it = range.first; it != range.second; ++it)
+				{
+					if (it->second == last)
+					{
+						m_index.erase(it);
+						break;
+					}
+				}
+
+				m_bytes -= last->bytes;
+				m_entries.erase(last);
+				++m_evictions;
+			}
+		}
+
+		template <typename T>
+		void LruCache<T>::limit(size_t bytes)
+		{
+			std::lock_guard<std::mutex> lock(m);
+			m_limit = bytes;
+			trim(m_limit);
+		}
+
+		template <typename T>
+		void LruCache<T>::clear()
+		{
+			std::lock_guard<std::mutex> lock(m);
+			m_entries.clear();
+			m_index.clear();
+			m_bytes = 0;
+		}
+
+		template <typename T>
+		CacheStats LruCache<T>::stats() const
+		{
+			std::lock_guard<std::mutex> lock(m);
+			CacheStats out = { m_hits, m_misses, m_evictions, m_entries.size(), m_bytes, m_limit };
+			return out;
+		}
+	}
+}
+
+#endif // __GFX_LRU_CACHE_HPP__
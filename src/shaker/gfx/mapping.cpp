@@ -0,0 +1,67 @@
+#include "mapping.hpp"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace gfx { namespace font
+{
+#ifdef _WIN32
+	bool Mapping::open(const std::string& path)
+	{
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		DWORD size = GetFileSize(file, nullptr);
+		HANDLE mapping = size && size != INVALID_FILE_SIZE ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+		CloseHandle(file);
+		if (!mapping)
+			return false;
+
+		m_data = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mapping);
+		if (!m_data)
+			return false;
+
+		m_size = size;
+		return true;
+	}
+
+	Mapping::~Mapping()
+	{
+		if (m_data)
+			UnmapViewOfFile(m_data);
+	}
+#else
+	bool Mapping::open(const std::string& path)
+	{
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+
+		struct stat info;
+		void* view = MAP_FAILED;
+		if (!fstat(fd, &info) && info.st_size > 0)
+			view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (view == MAP_FAILED)
+			return false;
+
+		m_data = (const uint8_t*)view;
+		m_size = (size_t)info.st_size;
+		return true;
+	}
+
+	Mapping::~Mapping()
+	{
+		if (m_data)
+			munmap((void*)m_data, m_size);
+	}
+#endif
+}} // gfx::font
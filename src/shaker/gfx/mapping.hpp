@@ -0,0 +1,29 @@
+#ifndef __GFX_MAPPING_HPP__
+#define __GFX_MAPPING_HPP__
+
+#include <stdint.h>
+#include <string>
+
+namespace gfx
+{
+	namespace font
+	{
+		// A read-only view of a whole file, for fonts read in place.
+		class Mapping
+		{
+			const uint8_t* m_data;
+			size_t m_size;
+
+			Mapping(const Mapping&);
+			Mapping& operator=(const Mapping&);
+		public:
+			Mapping() : m_data(nullptr), m_size(0) {}
+			~Mapping();
+			bool open(const std::string& path);
+			const uint8_t* data() const { return m_data; }
+			size_t size() const { return m_size; }
+		};
+	}
+}
+
+#endif // __GFX_MAPPING_HPP__
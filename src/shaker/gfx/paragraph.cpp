@@ -0,0 +1,278 @@
+#include <shaker/gfx/paragraph.hpp>
+#include <shaker/gfx/utf8.hpp>
+#include <algorithm>
+#include <limits>
+
+namespace gfx { namespace font
+{
+	namespace
+	{
+		static const long UNLIMITED = std::numeric_limits<long>::max();
+	}
+
+	Paragraph::Paragraph(const ptr& font, const std::string& utf8, long width)
+		: m_font(font)
+		, m_width(width)
+		, m_lines(0)
+	{
+		set_text(utf8);
+	}
+
+	void Paragraph::set_text(const std::string& utf8)
+	{
+		m_text = utf8;
+		m_segments.clear();
+		split(0, m_text.size(), m_segments);
+		number(0);
+	}
+
+	// the runs between the '\n's of [begin, end), wrapped
+	void Paragraph::split(size_t begin, size_t end, std::vector<Segment>& out) const
+	{
+		for (;;)
+		{
+			size_t eol = m_text.find('\n', begin);
+			if (eol == std::string::npos || eol > end)
+				eol = end;
+
+			Segment segment;
+			segment.begin = begin;
+			segment.end = eol;
+			segment.first_line = 0;
+			wrap(segment);
+			out.push_back(segment);
+
+			if (eol == end)
+				return;
+			begin = eol + 1;
+		}
+	}
+
+	// Greedy: a line takes words while they fit, a word that does not fit
+	// on a line of its own is split between code points. The spaces at a
+	// break or ending the run are dropped, the ones starting it are kept.
+	void Paragraph::wrap(Segment& segment) const
+	{
+		long limit = m_width < 0 ? UNLIMITED : m_width;
+		long space = m_font->advance(' ');
+		const char* base = m_text.data() + segment.begin;
+		size_t size = segment.end - segment.begin;
+
+		segment.lines.clear();
+		segment.widest = 0;
+		segment.overflow = UNLIMITED;
+
+		Line line = { 0, 0, 0 };
+		bool empty = true;
+
+		auto emit = [&](long overflow, size_t next)
+		{
+			segment.lines.push_back(line);
+			segment.widest = std::max(segment.widest, line.width);
+			segment.overflow = std::min(segment.overflow, overflow);
+			line.begin = line.end = next;
+			line.width = 0;
+			empty = true;
+		};
+
+		size_t pos = 0;
+		while (pos < size)
+		{
+			size_t gap_begin = pos;
+			while (pos < size && base[pos] == ' ')
+				++pos;
+			long gap = (long)(pos - gap_begin) * space;
+
+			size_t word_begin = pos;
+			while (pos < size && base[pos] != ' ')
+				++pos;
+			size_t word_end = pos;
+			if (word_begin == word_end)
+				break; // trailing spaces hang past the width
+
+			long word = 0;
+			for (auto code_point : utf8::view(base + word_begin, base + word_end))
+				word += m_font->advance(code_point);
+
+			if (!empty)
+			{
+				if (line.width + gap + word <= limit)
+				{
+					line.width += gap + word;
+					line.end = word_end;
+					continue;
+				}
+				emit(line.width + gap + word, word_begin);
+				gap = 0;
+			}
+			else if (segment.lines.empty())
+			{
+				line.width += gap; // the run's indentation
+			}
+			else
+			{
+				line.begin = line.end = word_begin;
+				gap = 0;
+			}
+
+			if (line.width + word <= limit)
+			{
+				line.width += word;
+				line.end = word_end;
+				empty = false;
+				continue;
+			}
+
+			// too long for a line: as many code points as fit, at least one
+			utf8::view letters(base + word_begin, base + word_end);
+			for (auto cur = letters.begin(), end = letters.end(); cur != end; ++cur)
+			{
+				long advance = m_font->advance(*cur);
+				size_t at = cur.position() - base;
+				if (line.end > line.begin && line.width + advance > limit)
+					emit(line.width + advance, at);
+				line.width += advance;
+				line.end = cur.next() - base;
+				empty = false;
+			}
+		}
+
+		segment.lines.push_back(line);
+		segment.widest = std::max(segment.widest, line.width);
+	}
+
+	// first_line of the segments from the given one on, and the line count
+	void Paragraph::number(size_t from)
+	{
+		size_t line = from ? m_segments[from - 1].first_line + m_segments[from - 1].lines.size() : 0;
+		for (size_t i = from; i < m_segments.size(); ++i)
+		{
+			m_segments[i].first_line = line;
+			line += m_segments[i].lines.size();
+		}
+		m_lines = line;
+	}
+
+	void Paragraph::replace(size_t begin, size_t length, const std::string& utf8)
+	{
+		if (begin > m_text.size())
+			begin = m_text.size();
+		if (length > m_text.size() - begin)
+			length = m_text.size() - begin;
+
+		// the runs touching [begin, begin + length], in the old text
+		auto first = std::lower_bound(m_segments.begin(), m_segments.end(), begin,
+			[](const Segment& segment, size_t at) { return segment.end < at; });
+		auto last = std::lower_bound(first, m_segments.end(), begin + length,
+			[](const Segment& segment, size_t at) { return segment.end < at; });
+
+		size_t from = first - m_segments.begin();
+		size_t region_begin = first->begin;
+		size_t region_end = last->end;
+
+		m_text.replace(begin, length, utf8);
+		ptrdiff_t delta = (ptrdiff_t)utf8.size() - (ptrdiff_t)length;
+
+		std::vector<Segment> rewrapped;
+		split(region_begin, region_end + delta, rewrapped);
+
+		auto after = m_segments.erase(first, last + 1);
+		for (auto cur = after; cur != m_segments.end(); ++cur)
+		{
+			cur->begin += delta;
+			cur->end += delta;
+		}
+		m_segments.insert(m_segments.begin() + from, rewrapped.begin(), rewrapped.end());
+		number(from);
+	}
+
+	void Paragraph::set_width(long width)
+	{
+		if (width < 0)
+			width = NO_WRAP;
+		if (width == m_width)
+			return;
+
+		m_width = width;
+		long limit = width < 0 ? UNLIMITED : width;
+
+		size_t from = m_segments.size();
+		for (size_t i = 0; i < m_segments.size(); ++i)
+		{
+			auto& segment = m_segments[i];
+			if (segment.widest <= limit && limit < segment.overflow)
+				continue;
+
+			size_t before = segment.lines.size();
+			wrap(segment);
+			if (segment.lines.size() != before && from > i)
+				from = i;
+		}
+
+		if (from < m_segments.size())
+			number(from);
+	}
+
+	size_t Paragraph::segment_of_line(size_t index) const
+	{
+		auto found = std::upper_bound(m_segments.begin(), m_segments.end(), index,
+			[](size_t at, const Segment& segment) { return at < segment.first_line; });
+		return (found - m_segments.begin()) - 1;
+	}
+
+	Paragraph::Line Paragraph::line(size_t index) const
+	{
+		const Segment& segment = m_segments[segment_of_line(index)];
+		Line out = segment.lines[index - segment.first_line];
+		out.begin += segment.begin;
+		out.end += segment.begin;
+		return out;
+	}
+
+	std::tuple<size_t, size_t> Paragraph::size() const
+	{
+		long widest = 0;
+		for (auto&& segment : m_segments)
+			widest = std::max(widest, segment.widest);
+
+		size_t gap = m_font->line_height() - m_font->height();
+		return std::make_tuple((size_t)widest, m_lines * m_font->height() + (m_lines - 1) * gap);
+	}
+
+	void Paragraph::paint(int x, int y, uint32_t color, Canvas* canvas, size_t first, size_t count) const
+	{
+		if (first >= m_lines)
+			return;
+		if (count > m_lines - first)
+			count = m_lines - first;
+
+		long step = m_font->line_height();
+		size_t index = segment_of_line(first);
+		size_t row = first;
+		std::string text;
+		for (; index < m_segments.size() && row < first + count; ++index)
+		{
+			const Segment& segment = m_segments[index];
+			for (size_t i = row - segment.first_line; i < segment.lines.size() && row < first + count; ++i, ++row)
+			{
+				const Line& line = segment.lines[i];
+				text.assign(m_text, segment.begin + line.begin, line.end - line.begin);
+				m_font->paint(text, x, y + (int)(row * step), color, canvas);
+			}
+		}
+	}
+
+	void Paragraph::paint(int x, int y, uint32_t color, Canvas* canvas) const
+	{
+		long step = m_font->line_height();
+		if (step <= 0)
+			return;
+
+		long top = y < 0 ? -y / step : 0;
+		long bottom = (canvas->height() - y + step - 1) / step;
+		if (bottom <= top)
+			return;
+
+		paint(x, y, color, canvas, (size_t)top, (size_t)(bottom - top));
+	}
+}} // gfx::font
@@ -0,0 +1,130 @@
+#include "raster.hpp"
+#include <math.h>
+
+namespace gfx { namespace font
+{
+	Raster::Raster(int width, int height)
+		: m_width(width)
+		, m_height(height)
+		, m_cells(width * height + 2) // an edge on the right border spills over
+	{
+	}
+
+	void Raster::line(float x0, float y0, float x1, float y1)
+	{
+		if (y0 == y1)
+			return;
+
+		float dir = 1.0f;
+		if (y0 > y1)
+		{
+			dir = -1.0f;
+			float t;
+			t = x0; x0 = x1; x1 = t;
+			t = y0; y0 = y1; y1 = t;
+		}
+
+		float dxdy = (x1 - x0) / (y1 - y0);
+		float x = x0;
+		if (y0 < 0)
+			x -= y0 * dxdy;
+
+		int top = y0 < 0 ? 0 : (int)y0;
+		int bottom = y1 > m_height ? m_height : (int)ceilf(y1);
+		float width = (float)m_width;
+
+		for (int y = top; y < bottom; ++y)
+		{
+			float* row = m_cells.data() + y * m_width;
+			float dy = (y + 1 < y1 ? y + 1 : y1) - (y > y0 ? y : y0);
+			float next = x + dxdy * dy;
+			float d = dy * dir;
+
+			float left = x < next ? x : next;
+			float right = x < next ? next : x;
+			if (left < 0) left = 0;
+			if (right > width) right = width;
+			if (left > width) left = width;
+			if (right < 0) right = 0;
+
+			float left_floor = floorf(left);
+			int left_cell = (int)left_floor;
+			float right_ceil = ceilf(right);
+			int right_cell = (int)right_ceil;
+
+			if (right_cell <= left_cell + 1)
+			{
+				// within one cell: split by the mean x
+				float mid = 0.5f * (left + right) - left_floor;
+				row[left_cell] += d - d * mid;
+				row[left_cell + 1] += d * mid;
+			}
+			else
+			{
+				float s = 1.0f / (right - left);
+				float left_frac = left - left_floor;
+				float first = 0.5f * s * (1 - left_frac) * (1 - left_frac);
+				float right_frac = right - right_ceil + 1;
+				float last = 0.5f * s * right_frac * right_frac;
+
+				row[left_cell] += d * first;
+				if (right_cell == left_cell + 2)
+				{
+					row[left_cell + 1] += d * (1 - first - last);
+				}
+				else
+				{
+					float second = s * (1.5f - left_frac);
+					row[left_cell + 1] += d * (second - first);
+					for (int cell = left_cell + 2; cell < right_cell - 1; ++cell)
+						row[cell] += d * s;
+					float middle = second + (right_cell - left_cell - 3) * s;
+					row[right_cell - 1] += d * (1 - middle - last);
+				}
+				row[right_cell] += d * last;
+			}
+
+			x = next;
+		}
+	}
+
+	void Raster::quad(float x0, float y0, float cx, float cy, float x1, float y1)
+	{
+		// enough segments to stay within about a third of a pixel
+		float ddx = x0 - 2 * cx + x1;
+		float ddy = y0 - 2 * cy + y1;
+		float deviation = ddx * ddx + ddy * ddy;
+		int segments = 1 + (int)sqrtf(sqrtf(3 * deviation));
+		if (segments > 64)
+			segments = 64;
+
+		float step = 1.0f / segments;
+		float px = x0, py = y0;
+		for (int i = 1; i <= segments; ++i)
+		{
+			float t = i == segments ? 1.0f : i * step;
+			float u = 1 - t;
+			float x = u * u * x0 + 2 * u * t * cx + t * t * x1;
+			float y = u * u * y0 + 2 * u * t * cy + t * t * y1;
+			line(px, py, x, y);
+			px = x;
+			py = y;
+		}
+	}
+
+	void Raster::coverage(uint8_t* out, int stride) const
+	{
+		float sum = 0;
+		const float* cell = m_cells.data();
+		for (int y = 0; y < m_height; ++y)
+		{
+			uint8_t* dst = out + y * stride;
+			for (int x = 0; x < m_width; ++x)
+			{
+				sum += *cell++;
+				float a = fabsf(sum);
+				dst[x] = a >= 1.0f ? 255 : (uint8_t)(a * 255.0f + 0.5f);
+			}
+		}
+	}
+}} // gfx::font
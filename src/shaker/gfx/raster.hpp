@@ -0,0 +1,69 @@
+#ifndef __GFX_RASTER_HPP__
+#define __GFX_RASTER_HPP__
+
+#include <shaker/gfx/font.hpp>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+namespace gfx
+{
+	namespace font
+	{
+		// Exact-area coverage of closed outlines made of lines and quadratic
+		// curves. Every edge adds its signed area to the cells it crosses and
+		// a running sum over the cells gives the coverage; the winding rule is
+		// non-zero, clamped to full coverage.
+		class Raster
+		{
+		public:
+			Raster(int width, int height);
+
+			int width() const { return m_width; }
+			int height() const { return m_height; }
+
+			void line(float x0, float y0, float x1, float y1);
+			void quad(float x0, float y0, float cx, float cy, float x1, float y1);
+
+			// width * height bytes, rows of stride bytes
+			void coverage(uint8_t* out, int stride) const;
+
+		private:
+			int m_width, m_height;
+			std::vector<float> m_cells;
+		};
+
+		// RasterStats kept up to date from any thread
+		class RasterCounters
+		{
+		public:
+			typedef std::chrono::steady_clock clock;
+
+			RasterCounters() : m_glyphs(0), m_pixels(0), m_microseconds(0) {}
+
+			void add(clock::duration elapsed, size_t pixels)
+			{
+				++m_glyphs;
+				m_pixels += pixels;
+				m_microseconds += std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+			}
+
+			RasterStats stats() const
+			{
+				RasterStats out = { m_glyphs, m_pixels, m_microseconds };
+				return out;
+			}
+
+		private:
+			RasterCounters(const RasterCounters&);
+			RasterCounters& operator=(const RasterCounters&);
+
+			std::atomic<uint64_t> m_glyphs;
+			std::atomic<uint64_t> m_pixels;
+			std::atomic<uint64_t> m_microseconds;
+		};
+	}
+}
+
+#endif // __GFX_RASTER_HPP__
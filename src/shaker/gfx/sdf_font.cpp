@@ -0,0 +1,257 @@
+#include "sdf_font.hpp"
+#include "distance_field.hpp"
+#include "mapping.hpp"
+#include <shaker/gfx/alpha_mask.hpp>
+#include <shaker/gfx/utf8.hpp>
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+namespace gfx { namespace font
+{
+	// the outline's box at the reference size, with room for the field
+	// to fall to zero around it
+	SdfFace::Field::Field(const TrueType& face, uint32_t glyph, float scale, GlyphAtlas& atlas)
+		: m_x(0)
+		, m_y(0)
+	{
+		TrueType::Box box;
+		if (!face.box(glyph, box))
+			return;
+
+		int pad = SPREAD + 1;
+		m_x = (int)floorf(box.x_min * scale) - pad;
+		m_y = (int)floorf(-box.y_max * scale) - pad;
+		int width = (int)ceilf(box.x_max * scale) + pad - m_x;
+		int height = (int)ceilf(-box.y_min * scale) + pad - m_y;
+
+		Raster raster(width, height);
+		TrueType::Transform transform = { scale, 0, 0, -scale, (float)-m_x, (float)-m_y };
+		face.outline(glyph, transform, raster);
+
+		std::vector<uint8_t> coverage(width * height);
+		raster.coverage(coverage.data(), width);
+
+		m_region = atlas.allocate(width, height);
+		if (m_region.page)
+			distance_field(coverage.data(), width, height, width, SPREAD, m_region.data(), m_region.stride());
+	}
+
+	SdfFace::Field::Field(const Field& other, GlyphAtlas& atlas)
+		: m_x(other.m_x)
+		, m_y(other.m_y)
+	{
+		if (other.empty())
+			return;
+
+		m_region = atlas.allocate(other.m_region.width, other.m_region.height);
+		if (!m_region.page)
+			return;
+
+		for (int y = 0; y < m_region.height; ++y)
+			memcpy(m_region.data() + y * m_region.stride(), other.m_region.data() + y * other.m_region.stride(), m_region.width);
+	}
+
+	SdfFace::Field::~Field()
+	{
+		GlyphAtlas::release(m_region);
+	}
+
+	SdfFace::SdfFace(const owner_ptr& owner)
+		: m_owner(owner)
+		, m_scale(0)
+		, m_atlas(ATLAS_PAGE_SIZE, ATLAS_PAGES)
+		, m_fields(CACHE_BYTES)
+	{
+	}
+
+	std::shared_ptr<SdfFace> SdfFace::load(const uint8_t* data, size_t size, const owner_ptr& owner)
+	{
+		if (!data)
+			return nullptr;
+
+		std::shared_ptr<SdfFace> face(new SdfFace(owner));
+		if (!face->m_face.parse(data, size))
+			return nullptr;
+
+		auto& metrics = face->m_face.metrics();
+		face->m_scale = (float)REFERENCE_HEIGHT / (metrics.ascender - metrics.descender);
+		return face;
+	}
+
+	ptr SdfFace::at(int pixel_height)
+	{
+		if (pixel_height <= 0)
+			return nullptr;
+		return std::make_shared<SdfFont>(shared_from_this(), pixel_height);
+	}
+
+	// made under the cache's lock, like GdiFont::glyph(): a drop() of the
+	// page the field was just given cannot slip in before it is cached
+	SdfFace::field_ptr SdfFace::field(uint32_t glyph)
+	{
+		auto out = m_fields.get(glyph, [this, glyph]() -> field_ptr
+		{
+			auto started = RasterCounters::clock::now();
+			auto made = std::make_shared<Field>(m_face, glyph, m_scale, m_atlas);
+			if (!made->empty())
+				m_counters.add(RasterCounters::clock::now() - started, made->footprint() - sizeof(Field));
+			return made;
+		});
+
+		// same page management as GdiFont::glyph()
+		if (m_atlas.evicted())
+		{
+			drop(m_atlas.take_evicted());
+			compact();
+		}
+
+		return out;
+	}
+
+	int32_t SdfFace::advance(uint32_t code_point) const
+	{
+		return m_advances.get(code_point, [this](uint32_t first, int count, int32_t* out)
+		{
+			for (int i = 0; i < count; ++i)
+				out[i] = m_face.advance(m_face.glyph(first + i));
+		});
+	}
+
+	void SdfFace::drop(const std::vector<GlyphAtlas::page_ptr>& pages)
+	{
+		m_fields.update([&](const field_ptr& field) -> field_ptr
+		{
+			return std::find(pages.begin(), pages.end(), field->page()) == pages.end() ? field : nullptr;
+		});
+	}
+
+	void SdfFace::compact()
+	{
+		auto retired = m_atlas.defragment();
+		if (retired.empty())
+			return;
+
+		m_fields.update([&](const field_ptr& field) -> field_ptr
+		{
+			if (std::find(retired.begin(), retired.end(), field->page()) == retired.end())
+				return field;
+			return std::make_shared<Field>(*field, m_atlas);
+		});
+	}
+
+	SdfFont::SdfFont(const std::shared_ptr<SdfFace>& face, int pixel_height)
+		: m_face(face)
+	{
+		auto& metrics = face->face().metrics();
+		m_scale = (float)pixel_height / (metrics.ascender - metrics.descender);
+		m_zoom = (float)pixel_height / SdfFace::REFERENCE_HEIGHT;
+		m_asc = (long)ceilf(metrics.ascender * m_scale);
+		m_desc = pixel_height - m_asc;
+		m_gap = metrics.line_gap > 0 ? (long)(metrics.line_gap * m_scale + 0.5f) : 0;
+	}
+
+	// pen positions stay fractional, so the layout scales with the size
+	void SdfFont::paint(const std::string& utf8, int x, int y, uint32_t color, Canvas* canvas) const
+	{
+		color |= 0xFF000000;
+
+		const TrueType& face = m_face->face();
+		float pen = (float)x;
+		float baseline = (float)(y + m_asc);
+
+		for (auto code_point : utf8::view(utf8))
+		{
+			if (code_point == '\n')
+			{
+				pen = (float)x;
+				baseline += line_height();
+				continue;
+			}
+
+			uint32_t glyph = face.glyph(code_point);
+			auto field = m_face->field(glyph);
+			if (!field->empty())
+				canvas->fill_field(pen + field->x() * m_zoom, baseline + field->y() * m_zoom, m_zoom, field->mask(), SdfFace::SPREAD, color);
+
+			pen += face.advance(glyph) * m_scale;
+		}
+	}
+
+	std::tuple<size_t, size_t> SdfFont::textSize(const std::string& utf8) const
+	{
+		float width = 0;
+		size_t lines = 1;
+		float line = 0;
+
+		for (auto code_point : utf8::view(utf8))
+		{
+			if (code_point == '\n')
+			{
+				if (width < line)
+					width = line;
+				line = 0;
+				++lines;
+				continue;
+			}
+
+			line += m_face->advance(code_point) * m_scale;
+		}
+
+		if (width < line)
+			width = line;
+
+		return std::make_tuple((size_t)ceilf(width), lines * height() + (lines - 1) * m_gap);
+	}
+
+	long SdfFont::advance(uint32_t code_point) const
+	{
+		return (long)(m_face->advance(code_point) * m_scale + 0.5f);
+	}
+
+	// Font::measure() with the fractional advances paint() uses
+	size_t SdfFont::measure(const std::string& utf8, long max_width, size_t* break_pos) const
+	{
+		float width = 0;
+		float line = 0;
+
+		utf8::view text(utf8);
+		for (auto cur = text.begin(), end = text.end(); cur != end; ++cur)
+		{
+			if (*cur == '\n')
+			{
+				if (width < line)
+					width = line;
+				line = 0;
+				continue;
+			}
+
+			float advance = m_face->advance(*cur) * m_scale;
+			if (max_width >= 0 && line + advance > max_width)
+			{
+				if (break_pos)
+					*break_pos = cur.position() - utf8.data();
+				return (size_t)ceilf(width < line ? line : width);
+			}
+			line += advance;
+		}
+
+		if (break_pos)
+			*break_pos = utf8.size();
+		return (size_t)ceilf(width < line ? line : width);
+	}
+
+	face_ptr distance_field(const void* data, size_t size)
+	{
+		return SdfFace::load((const uint8_t*)data, size, nullptr);
+	}
+
+	face_ptr distance_field(const std::string& path)
+	{
+		auto mapping = std::make_shared<Mapping>();
+		if (!mapping->open(path))
+			return nullptr;
+
+		return SdfFace::load(mapping->data(), mapping->size(), mapping);
+	}
+}} // gfx::font
@@ -0,0 +1,108 @@
+#ifndef __GFX_SDF_FONT_HPP__
+#define __GFX_SDF_FONT_HPP__
+
+#include <shaker/gfx/font.hpp>
+#include "advance_table.hpp"
+#include "glyph_atlas.hpp"
+#include "glyph_cache.hpp"
+#include "raster.hpp"
+#include "truetype.hpp"
+#include <memory>
+
+namespace gfx
+{
+	namespace font
+	{
+		// TrueType glyphs kept as distance fields in an atlas.
+		//
+		// Each glyph is rasterized once, REFERENCE_HEIGHT pixels from
+		// ascender to descender, and turned into a field reaching SPREAD
+		// pixels either side of the outline. Fonts of any size made by at()
+		// paint the same fields, stretched by Canvas::fill_field(), so zooming
+		// neither rasterizes again nor grows the cache.
+		class SdfFace : public Face, public std::enable_shared_from_this<SdfFace>
+		{
+		public:
+			enum
+			{
+				REFERENCE_HEIGHT = 48,
+				SPREAD = 6,
+				ATLAS_PAGE_SIZE = 512,
+				ATLAS_PAGES = 4,
+				CACHE_BYTES = 1024 * 1024
+			};
+
+			// keeps the memory alive, e.g. a file mapping
+			typedef std::shared_ptr<const void> owner_ptr;
+
+			class Field
+			{
+				GlyphAtlas::Region m_region;
+				int m_x, m_y;  // top-left corner relative to the pen, in reference pixels
+
+				Field(const Field&);
+				Field& operator=(const Field&);
+			public:
+				Field(const TrueType& face, uint32_t glyph, float scale, GlyphAtlas& atlas);
+				Field(const Field& other, GlyphAtlas& atlas); // moves the field to a new region
+				~Field();
+				bool empty() const { return !m_region.page; }
+				AlphaMask mask() const { return m_region.mask(); }
+				const GlyphAtlas::page_ptr& page() const { return m_region.page; }
+				int x() const { return m_x; }
+				int y() const { return m_y; }
+				size_t footprint() const { return sizeof(*this) + m_region.area(); }
+			};
+			typedef std::shared_ptr<Field> field_ptr;
+
+			static std::shared_ptr<SdfFace> load(const uint8_t* data, size_t size, const owner_ptr& owner);
+
+			ptr at(int pixel_height) override;
+
+			const TrueType& face() const { return m_face; }
+			field_ptr field(uint32_t glyph);
+			int32_t advance(uint32_t code_point) const; // in font units, shared by every size
+
+			void cache_limit(size_t bytes) { m_fields.limit(bytes); }
+			CacheStats cache_stats() const { return m_fields.stats(); }
+			RasterStats raster_stats() const { return m_counters.stats(); }
+
+		private:
+			explicit SdfFace(const owner_ptr& owner);
+
+			void drop(const std::vector<GlyphAtlas::page_ptr>& pages);
+			void compact();
+
+			owner_ptr m_owner;
+			TrueType m_face;
+			float m_scale;  // font units to reference pixels
+			GlyphAtlas m_atlas;
+			GlyphCache<Field> m_fields;
+			AdvanceTable m_advances;
+			RasterCounters m_counters;
+		};
+
+		class SdfFont : public Font
+		{
+		public:
+			SdfFont(const std::shared_ptr<SdfFace>& face, int pixel_height);
+
+			long height() const override { return m_asc + m_desc; }
+			long asc() const override { return m_asc; }
+			long desc() const override { return m_desc; }
+			long line_height() const override { return m_asc + m_desc + m_gap; }
+			void paint(const std::string& utf8, int x, int y, uint32_t color, Canvas* canvas) const override;
+			std::tuple<size_t, size_t> textSize(const std::string& utf8) const override;
+			long advance(uint32_t code_point) const override;
+			size_t measure(const std::string& utf8, long max_width = -1, size_t* break_pos = nullptr) const override;
+
+		private:
+			std::shared_ptr<SdfFace> m_face;
+			float m_scale;  // font units to pixels
+			float m_zoom;   // reference pixels to pixels
+			long m_asc, m_desc, m_gap;
+		};
+	}
+}
+
+#endif // __GFX_SDF_FONT_HPP__
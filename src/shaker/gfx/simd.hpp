@@ -0,0 +1,41 @@
+#ifndef __GFX_SIMD_HPP__
+#define __GFX_SIMD_HPP__
+
+// Win32 builds target /arch:SSE2 (the VS2012+ default), x64 always has it.
+#if defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GFX_SSE2 1
+#include <emmintrin.h>
+#else
+#define GFX_SSE2 0
+#endif
+
+#include <stdint.h>
+#include <string.h>
+
+namespace gfx
+{
+	namespace simd
+	{
+		// unaligned loads of less than 16 bytes, safe for any source alignment
+		inline uint32_t load32(const void* src)
+		{
+			uint32_t out;
+			memcpy(&out, src, sizeof(out));
+			return out;
+		}
+
+#if GFX_SSE2
+		inline __m128i load4(const uint8_t* src) { return _mm_cvtsi32_si128((int)load32(src)); }
+		inline __m128i load8(const uint8_t* src) { return _mm_loadl_epi64((const __m128i*)src); }
+		inline __m128i load16(const void* src) { return _mm_loadu_si128((const __m128i*)src); }
+
+		// two int16 lanes (lo, hi) repeated, as a _mm_madd_epi16 operand
+		inline __m128i pair16(int lo, int hi)
+		{
+			return _mm_set1_epi32((int)(((uint32_t)(uint16_t)(int16_t)hi << 16) | (uint16_t)(int16_t)lo));
+		}
+#endif
+	}
+}
+
+#endif // __GFX_SIMD_HPP__
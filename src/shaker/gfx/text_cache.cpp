@@ -0,0 +1,127 @@
+#include <shaker/gfx/text_cache.hpp>
+#include <shaker/gfx/alpha_mask.hpp>
+#include "lru_cache.hpp"
+#include <vector>
+
+namespace gfx { namespace font
+{
+	namespace
+	{
+		// coverage of a string, placed relative to the point it was painted at
+		struct Run
+		{
+			std::vector<uint8_t> coverage;
+			int x, y, width, height;
+		};
+
+		// White over black leaves the coverage in every channel; green sits
+		// in the same place in both native pixel orders.
+		inline uint8_t coverage(uint32_t pixel)
+		{
+			return (pixel >> 8) & 0xFF;
+		}
+
+		std::shared_ptr<Run> render(const Font& font, const std::string& utf8, int width, int height, int pad)
+		{
+			int w = width + 2 * pad;
+			int h = height + 2 * pad;
+			std::vector<uint32_t> pixels(w * h, 0xFF000000);
+			Canvas canvas(pixels.data(), w, h);
+			font.paint(utf8, pad, pad, 0xFFFFFF, &canvas);
+
+			// keep only the inked part
+			int left = w, top = h, right = 0, bottom = 0;
+			for (int y = 0; y < h; ++y)
+			{
+				const uint32_t* row = pixels.data() + y * w;
+				for (int x = 0; x < w; ++x)
+				{
+					if (!coverage(row[x]))
+						continue;
+					if (left > x) left = x;
+					if (right < x + 1) right = x + 1;
+					if (top > y) top = y;
+					bottom = y + 1;
+				}
+			}
+
+			auto run = std::make_shared<Run>();
+			run->x = left - pad;
+			run->y = top - pad;
+			run->width = right > left ? right - left : 0;
+			run->height = bottom > top ? bottom - top : 0;
+			if (!run->width || !run->height)
+				return run;
+
+			run->coverage.resize(run->width * run->height);
+			for (int y = 0; y < run->height; ++y)
+			{
+				const uint32_t* src = pixels.data() + left + (top + y) * w;
+				uint8_t* dst = run->coverage.data() + y * run->width;
+				for (int x = 0; x < run->width; ++x)
+					dst[x] = coverage(src[x]);
+			}
+			return run;
+		}
+	}
+
+	struct CachedFont::Runs
+	{
+		LruCache<Run> cache;
+		explicit Runs(size_t budget) : cache(budget) {}
+	};
+
+	CachedFont::CachedFont(const ptr& font, size_t budget)
+		: m_font(font)
+		, m_runs(new Runs(budget))
+	{
+	}
+
+	CachedFont::~CachedFont()
+	{
+	}
+
+	void CachedFont::paint(const std::string& utf8, int x, int y, uint32_t color, Canvas* canvas) const
+	{
+		auto run = m_runs->cache.find(utf8);
+		if (!run)
+		{
+			auto size = m_font->textSize(utf8);
+			int width = (int)std::get<0>(size);
+			int height = (int)std::get<1>(size);
+
+			// room for glyphs reaching outside of their advance
+			int pad = m_font->height() / 2 + 1;
+
+			// strings too big to ever fit in the cache are painted directly
+			size_t area = (size_t)(width + 2 * pad) * (height + 2 * pad);
+			if (area > m_runs->cache.stats().limit)
+			{
+				m_font->paint(utf8, x, y, color, canvas);
+				return;
+			}
+
+			// a run missing glyphs still being rasterized is shown, but not kept
+			uint64_t skipped = m_font->skipped_glyphs();
+			auto rendered = render(*m_font, utf8, width, height, pad);
+			if (m_font->skipped_glyphs() == skipped)
+				m_runs->cache.insert(utf8, rendered, sizeof(Run) + rendered->coverage.size());
+			run = rendered;
+		}
+
+		if (run->coverage.empty())
+			return;
+
+		canvas->fill_mask(x + run->x, y + run->y, AlphaMask(run->coverage.data(), run->width, run->height), color | 0xFF000000);
+	}
+
+	void CachedFont::limit(size_t bytes)
+	{
+		m_runs->cache.limit(bytes);
+	}
+
+	CacheStats CachedFont::stats() const
+	{
+		return m_runs->cache.stats();
+	}
+}} // gfx::font
@@ -0,0 +1,540 @@
+#include "truetype.hpp"
+#include "raster.hpp"
+
+namespace gfx { namespace font
+{
+	namespace
+	{
+		inline uint16_t u16(const uint8_t* p) { return (uint16_t)((p[0] << 8) | p[1]); }
+		inline int16_t i16(const uint8_t* p) { return (int16_t)u16(p); }
+		inline uint32_t u32(const uint8_t* p) { return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]; }
+		inline float f2dot14(const uint8_t* p) { return i16(p) / 16384.0f; }
+
+		inline uint32_t tag(const char* name)
+		{
+			return ((uint32_t)(uint8_t)name[0] << 24) | ((uint8_t)name[1] << 16) | ((uint8_t)name[2] << 8) | (uint8_t)name[3];
+		}
+
+		// simple glyph point flags
+		enum
+		{
+			ON_CURVE = 0x01,
+			X_SHORT = 0x02,
+			Y_SHORT = 0x04,
+			REPEAT = 0x08,
+			X_SAME_OR_POSITIVE = 0x10,
+			Y_SAME_OR_POSITIVE = 0x20
+		};
+
+		// composite glyph component flags
+		enum
+		{
+			ARGS_ARE_WORDS = 0x0001,
+			ARGS_ARE_XY = 0x0002,
+			HAVE_SCALE = 0x0008,
+			MORE_COMPONENTS = 0x0020,
+			HAVE_XY_SCALE = 0x0040,
+			HAVE_2X2 = 0x0080
+		};
+
+		// nested composites deeper than this are treated as a loop
+		static const int MAX_DEPTH = 8;
+	}
+
+	TrueType::TrueType()
+		: m_data(nullptr)
+		, m_size(0)
+		, m_glyphs(0)
+		, m_long_offsets(false)
+		, m_metric_count(0)
+		, m_cmap(nullptr)
+		, m_cmap_length(0)
+		, m_cmap_format(0)
+	{
+		Metrics none = {};
+		m_metrics = none;
+		Table empty = {};
+		m_hmtx = m_loca = m_glyf = empty;
+	}
+
+	bool TrueType::table(uint32_t name, Table& out) const
+	{
+		// a collection starts with the offsets of its fonts; use the first
+		uint32_t base = 0;
+		if (m_size >= 16 && u32(m_data) == tag("ttcf"))
+			base = u32(m_data + 12);
+
+		if (base > m_size || m_size - base < 12)
+			return false;
+
+		uint32_t count = u16(m_data + base + 4);
+		const uint8_t* record = m_data + base + 12;
+		if ((size_t)(m_data + m_size - record) < count * 16)
+			return false;
+
+		for (uint32_t i = 0; i < count; ++i, record += 16)
+		{
+			if (u32(record) != name)
+				continue;
+
+			out.offset = u32(record + 8);
+			out.length = u32(record + 12);
+			return out.offset <= m_size && out.length <= m_size - out.offset;
+		}
+		return false;
+	}
+
+	bool TrueType::parse(const uint8_t* data, size_t size)
+	{
+		m_data = data;
+		m_size = size;
+
+		Table head, maxp, hhea;
+		if (!table(tag("head"), head) || head.length < 54
+			|| !table(tag("maxp"), maxp) || maxp.length < 6
+			|| !table(tag("hhea"), hhea) || hhea.length < 36
+			|| !table(tag("hmtx"), m_hmtx)
+			|| !table(tag("loca"), m_loca)
+			|| !table(tag("glyf"), m_glyf))
+		{
+			return false;
+		}
+
+		m_metrics.units_per_em = u16(m_data + head.offset + 18);
+		m_long_offsets = i16(m_data + head.offset + 50) != 0;
+		m_glyphs = u16(m_data + maxp.offset + 4);
+		m_metrics.ascender = i16(m_data + hhea.offset + 4);
+		m_metrics.descender = i16(m_data + hhea.offset + 6);
+		m_metrics.line_gap = i16(m_data + hhea.offset + 8);
+		m_metric_count = u16(m_data + hhea.offset + 34);
+
+		if (!m_metrics.units_per_em || !m_glyphs || m_metrics.ascender <= m_metrics.descender)
+			return false;
+		if (!m_metric_count || m_hmtx.length / 4 < m_metric_count)
+			return false;
+		if (m_loca.length / (m_long_offsets ? 4 : 2) < m_glyphs + 1)
+			return false;
+
+		Table map;
+		if (!table(tag("cmap"), map) || !cmap(map))
+			return false;
+
+		for (uint32_t c = 0; c < 128; ++c)
+			m_ascii[c] = (uint16_t)lookup(c);
+
+		return true;
+	}
+
+	// picks a Unicode subtable: full repertoire (format 12) over BMP (format 4)
+	bool TrueType::cmap(const Table& cmap)
+	{
+		if (cmap.length < 4)
+			return false;
+
+		const uint8_t* base = m_data + cmap.offset;
+		uint32_t count = u16(base + 2);
+		if ((cmap.length - 4) / 8 < count)
+			return false;
+
+		int best = 0;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const uint8_t* record = base + 4 + i * 8;
+			int platform = u16(record);
+			int encoding = u16(record + 2);
+			uint32_t offset = u32(record + 4);
+
+			bool unicode = platform == 0 || (platform == 3 && (encoding == 1 || encoding == 10));
+			if (!unicode || offset > cmap.length - 4)
+				continue;
+
+			const uint8_t* sub = base + offset;
+			int format = u16(sub);
+			uint32_t length;
+			if (format == 4)
+				length = u16(sub + 2);
+			else if (format == 12 && offset <= cmap.length - 8)
+				length = u32(sub + 4);
+			else
+				continue;
+
+			if (length > cmap.length - offset || format <= best)
+				continue;
+
+			if (format == 4 && (length < 16 || (length - 16) / 8 < (uint32_t)(u16(sub + 6) / 2)))
+				continue;
+			if (format == 12 && (length < 16 || (length - 16) / 12 < u32(sub + 12)))
+				continue;
+
+			best = format;
+			m_cmap = sub;
+			m_cmap_length = length;
+			m_cmap_format = format;
+		}
+
+		return best != 0;
+	}
+
+	uint32_t TrueType::lookup(uint32_t code_point) const
+	{
+		if (m_cmap_format == 12)
+		{
+			uint32_t groups = u32(m_cmap + 12);
+			const uint8_t* group = m_cmap + 16;
+			uint32_t lo = 0, hi = groups;
+			while (lo < hi)
+			{
+				uint32_t mid = (lo + hi) / 2;
+				const uint8_t* g = group + mid * 12;
+				if (code_point < u32(g))
+					hi = mid;
+				else if (code_point > u32(g + 4))
+					lo = mid + 1;
+				else
+					return u32(g + 8) + (code_point - u32(g));
+			}
+			return 0;
+		}
+
+		if (code_point > 0xFFFF)
+			return 0;
+
+		// format 4: segments sorted by their last code point
+		uint32_t segments = u16(m_cmap + 6) / 2;
+		const uint8_t* ends = m_cmap + 14;
+		const uint8_t* starts = ends + segments * 2 + 2;
+		const uint8_t* deltas = starts + segments * 2;
+		const uint8_t* ranges = deltas + segments * 2;
+
+		uint32_t lo = 0, hi = segments;
+		while (lo < hi)
+		{
+			uint32_t mid = (lo + hi) / 2;
+			if (u16(ends + mid * 2) < code_point)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		if (lo == segments)
+			return 0;
+
+		uint32_t start = u16(starts + lo * 2);
+		if (code_point < start)
+			return 0;
+
+		uint16_t delta = u16(deltas + lo * 2);
+		uint32_t range = u16(ranges + lo * 2);
+		if (!range)
+			return (uint16_t)(code_point + delta);
+
+		const uint8_t* id = ranges + lo * 2 + range + (code_point - start) * 2;
+		if (id + 2 > m_cmap + m_cmap_length)
+			return 0;
+
+		uint32_t glyph = u16(id);
+		return glyph ? (uint16_t)(glyph + delta) : 0;
+	}
+
+	uint32_t TrueType::glyph(uint32_t code_point) const
+	{
+		uint32_t out = code_point < 128 ? m_ascii[code_point] : lookup(code_point);
+		return out < m_glyphs ? out : 0;
+	}
+
+	int TrueType::advance(uint32_t glyph) const
+	{
+		// glyphs past the last metric share its advance
+		if (glyph >= m_metric_count)
+			glyph = m_metric_count - 1;
+		return u16(m_data + m_hmtx.offset + glyph * 4);
+	}
+
+	bool TrueType::locate(uint32_t glyph, const uint8_t*& data, size_t& length) const
+	{
+		if (glyph >= m_glyphs)
+			return false;
+
+		const uint8_t* loca = m_data + m_loca.offset;
+		uint32_t begin, end;
+		if (m_long_offsets)
+		{
+			begin = u32(loca + glyph * 4);
+			end = u32(loca + glyph * 4 + 4);
+		}
+		else
+		{
+			begin = u16(loca + glyph * 2) * 2;
+			end = u16(loca + glyph * 2 + 2) * 2;
+		}
+
+		if (end <= begin || end > m_glyf.length || end - begin < 10)
+			return false;
+
+		data = m_data + m_glyf.offset + begin;
+		length = end - begin;
+		return true;
+	}
+
+	bool TrueType::box(uint32_t glyph, Box& out) const
+	{
+		const uint8_t* data;
+		size_t length;
+		if (!locate(glyph, data, length))
+			return false;
+
+		out.x_min = i16(data + 2);
+		out.y_min = i16(data + 4);
+		out.x_max = i16(data + 6);
+		out.y_max = i16(data + 8);
+		return out.x_min < out.x_max && out.y_min < out.y_max;
+	}
+
+	void TrueType::outline(uint32_t glyph, const Transform& transform, Raster& raster) const
+	{
+		outline(glyph, transform, raster, 0);
+	}
+
+	void TrueType::outline(uint32_t glyph, const Transform& transform, Raster& raster, int depth) const
+	{
+		const uint8_t* data;
+		size_t length;
+		if (depth > MAX_DEPTH || !locate(glyph, data, length))
+			return;
+
+		int contours = i16(data);
+		if (contours > 0)
+			simple(data, length, contours, transform, raster);
+		else if (contours < 0)
+			composite(data, length, transform, raster, depth);
+	}
+
+	bool TrueType::simple(const uint8_t* data, size_t length, int contours, const Transform& t, Raster& raster) const
+	{
+		const uint8_t* end = data + length;
+		const uint8_t* ends = data + 10;
+		const uint8_t* cur = ends + contours * 2;
+		if (cur + 2 > end)
+			return false;
+
+		int points = u16(cur - 2) + 1;
+		cur += 2 + u16(cur); // skip the instructions
+		if (cur > end)
+			return false;
+
+		std::vector<uint8_t> flags(points);
+		for (int i = 0; i < points;)
+		{
+			if (cur >= end)
+				return false;
+			uint8_t flag = *cur++;
+			flags[i++] = flag;
+			if (flag & REPEAT)
+			{
+				if (cur >= end)
+					return false;
+				for (int n = *cur++; n > 0 && i < points; --n)
+					flags[i++] = flag;
+			}
+		}
+
+		// coordinates are deltas, all x first, then all y
+		std::vector<int> xs(points);
+		int value = 0;
+		for (int i = 0; i < points; ++i)
+		{
+			uint8_t flag = flags[i];
+			if (flag & X_SHORT)
+			{
+				if (cur >= end)
+					return false;
+				value += flag & X_SAME_OR_POSITIVE ? *cur : -*cur;
+				++cur;
+			}
+			else if (!(flag & X_SAME_OR_POSITIVE))
+			{
+				if (cur + 2 > end)
+					return false;
+				value += i16(cur);
+				cur += 2;
+			}
+			xs[i] = value;
+		}
+
+		std::vector<Point> transformed(points);
+		value = 0;
+		for (int i = 0; i < points; ++i)
+		{
+			uint8_t flag = flags[i];
+			if (flag & Y_SHORT)
+			{
+				if (cur >= end)
+					return false;
+				value += flag & Y_SAME_OR_POSITIVE ? *cur : -*cur;
+				++cur;
+			}
+			else if (!(flag & Y_SAME_OR_POSITIVE))
+			{
+				if (cur + 2 > end)
+					return false;
+				value += i16(cur);
+				cur += 2;
+			}
+
+			float x = (float)xs[i], y = (float)value;
+			transformed[i].x = t.a * x + t.c * y + t.e;
+			transformed[i].y = t.b * x + t.d * y + t.f;
+		}
+
+		int first = 0;
+		for (int c = 0; c < contours; ++c)
+		{
+			int last = u16(ends + c * 2);
+			if (last < first || last >= points)
+				return false;
+
+			contour(transformed.data() + first, flags.data() + first, last - first + 1, raster);
+			first = last + 1;
+		}
+		return true;
+	}
+
+	// Two off-curve points in a row have an implied on-curve point halfway
+	// between them. The contour starts at an on-curve point, real or implied.
+	void TrueType::contour(const Point* points, const uint8_t* flags, int count, Raster& raster)
+	{
+		if (count < 2)
+			return;
+
+		bool first_on = (flags[0] & ON_CURVE) != 0;
+		bool last_on = (flags[count - 1] & ON_CURVE) != 0;
+
+		Point start;
+		if (first_on)
+		{
+			start = points[0];
+		}
+		else if (last_on)
+		{
+			start = points[count - 1];
+		}
+		else
+		{
+			start.x = 0.5f * (points[0].x + points[count - 1].x);
+			start.y = 0.5f * (points[0].y + points[count - 1].y);
+		}
+
+		Point pen = start, control = start;
+		bool curve = false;
+		for (int i = 0; i < count; ++i)
+		{
+			// already the start
+			if ((i == 0 && first_on) || (i == count - 1 && !first_on && last_on))
+				continue;
+
+			const Point& p = points[i];
+			if (flags[i] & ON_CURVE)
+			{
+				if (curve)
+					raster.quad(pen.x, pen.y, control.x, control.y, p.x, p.y);
+				else
+					raster.line(pen.x, pen.y, p.x, p.y);
+				pen = p;
+				curve = false;
+			}
+			else
+			{
+				if (curve)
+				{
+					Point mid = { 0.5f * (control.x + p.x), 0.5f * (control.y + p.y) };
+					raster.quad(pen.x, pen.y, control.x, control.y, mid.x, mid.y);
+					pen = mid;
+				}
+				control = p;
+				curve = true;
+			}
+		}
+
+		if (curve)
+			raster.quad(pen.x, pen.y, control.x, control.y, start.x, start.y);
+		else
+			raster.line(pen.x, pen.y, start.x, start.y);
+	}
+
+	void TrueType::composite(const uint8_t* data, size_t length, const Transform& t, Raster& raster, int depth) const
+	{
+		const uint8_t* end = data + length;
+		const uint8_t* cur = data + 10;
+
+		for (;;)
+		{
+			if (cur + 4 > end)
+				return;
+			int flags = u16(cur);
+			uint32_t glyph = u16(cur + 2);
+			cur += 4;
+
+			float dx, dy;
+			if (flags & ARGS_ARE_WORDS)
+			{
+				if (cur + 4 > end)
+					return;
+				dx = i16(cur);
+				dy = i16(cur + 2);
+				cur += 4;
+			}
+			else
+			{
+				if (cur + 2 > end)
+					return;
+				dx = (int8_t)cur[0];
+				dy = (int8_t)cur[1];
+				cur += 2;
+			}
+
+			// components placed by matching points are drawn unmoved
+			if (!(flags & ARGS_ARE_XY))
+				dx = dy = 0;
+
+			float a = 1, b = 0, c = 0, d = 1;
+			if (flags & HAVE_SCALE)
+			{
+				if (cur + 2 > end)
+					return;
+				a = d = f2dot14(cur);
+				cur += 2;
+			}
+			else if (flags & HAVE_XY_SCALE)
+			{
+				if (cur + 4 > end)
+					return;
+				a = f2dot14(cur);
+				d = f2dot14(cur + 2);
+				cur += 4;
+			}
+			else if (flags & HAVE_2X2)
+			{
+				if (cur + 8 > end)
+					return;
+				a = f2dot14(cur);
+				b = f2dot14(cur + 2);
+				c = f2dot14(cur + 4);
+				d = f2dot14(cur + 6);
+				cur += 8;
+			}
+
+			Transform child =
+			{
+				t.a * a + t.c * b,
+				t.b * a + t.d * b,
+				t.a * c + t.c * d,
+				t.b * c + t.d * d,
+				t.a * dx + t.c * dy + t.e,
+				t.b * dx + t.d * dy + t.f
+			};
+			outline(glyph, child, raster, depth + 1);
+
+			if (!(flags & MORE_COMPONENTS))
+				return;
+		}
+	}
+}} // gfx::font
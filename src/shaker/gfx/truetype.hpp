@@ -0,0 +1,88 @@
+#ifndef __GFX_TRUETYPE_HPP__
+#define __GFX_TRUETYPE_HPP__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace gfx
+{
+	namespace font
+	{
+		class Raster;
+
+		// The tables of a TrueType font needed to draw it: head, maxp, hhea,
+		// hmtx, loca, glyf and cmap, read in place. Every read is checked
+		// against the size of the data, so a broken font draws nothing
+		// instead of reading past it. Hinting is not supported.
+		class TrueType
+		{
+		public:
+			struct Metrics
+			{
+				int units_per_em;
+				int ascender, descender, line_gap; // font units, y up
+			};
+
+			struct Box
+			{
+				int x_min, y_min, x_max, y_max;
+			};
+
+			// font units to pixels: (a x + c y + e, b x + d y + f)
+			struct Transform
+			{
+				float a, b, c, d, e, f;
+			};
+
+			TrueType();
+
+			bool parse(const uint8_t* data, size_t size);
+
+			const Metrics& metrics() const { return m_metrics; }
+			uint32_t glyphs() const { return m_glyphs; }
+
+			// 0, the missing glyph, for unmapped code points
+			uint32_t glyph(uint32_t code_point) const;
+			int advance(uint32_t glyph) const;
+
+			// false for glyphs without an outline, like the space
+			bool box(uint32_t glyph, Box& out) const;
+			void outline(uint32_t glyph, const Transform& transform, Raster& raster) const;
+
+		private:
+			struct Table
+			{
+				uint32_t offset, length;
+			};
+
+			struct Point
+			{
+				float x, y;
+			};
+
+			bool table(uint32_t tag, Table& out) const;
+			bool cmap(const Table& cmap);
+			uint32_t lookup(uint32_t code_point) const;
+			bool locate(uint32_t glyph, const uint8_t*& data, size_t& length) const;
+			void outline(uint32_t glyph, const Transform& transform, Raster& raster, int depth) const;
+			bool simple(const uint8_t* data, size_t length, int contours, const Transform& transform, Raster& raster) const;
+			void composite(const uint8_t* data, size_t length, const Transform& transform, Raster& raster, int depth) const;
+			static void contour(const Point* points, const uint8_t* flags, int count, Raster& raster);
+
+			const uint8_t* m_data;
+			size_t m_size;
+			Metrics m_metrics;
+			uint32_t m_glyphs;
+			bool m_long_offsets;
+			uint32_t m_metric_count;
+			Table m_hmtx, m_loca, m_glyf;
+			const uint8_t* m_cmap;
+			size_t m_cmap_length;
+			int m_cmap_format; // 4 or 12
+			uint16_t m_ascii[128]; // the glyphs of ASCII, looked up once
+		};
+	}
+}
+
+#endif // __GFX_TRUETYPE_HPP__
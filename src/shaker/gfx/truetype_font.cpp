@@ -0,0 +1,213 @@
+#include "truetype_font.hpp"
+#include <shaker/gfx/alpha_mask.hpp>
+#include <shaker/gfx/utf8.hpp>
+#include "mapping.hpp"
+#include <math.h>
+
+namespace gfx { namespace font
+{
+	TrueTypeFont::TrueTypeFont(const owner_ptr& owner, int pixel_height)
+		: m_owner(owner)
+		, m_pixel_height(pixel_height)
+		, m_scale(0)
+		, m_asc(0)
+		, m_desc(0)
+		, m_gap(0)
+		, m_bitmaps(CACHE_BYTES)
+	{
+	}
+
+	std::shared_ptr<TrueTypeFont> TrueTypeFont::load(const uint8_t* data, size_t size, int pixel_height, const owner_ptr& owner)
+	{
+		if (!data || pixel_height <= 0)
+			return nullptr;
+
+		std::shared_ptr<TrueTypeFont> font(new TrueTypeFont(owner, pixel_height));
+		if (!font->m_face.parse(data, size))
+			return nullptr;
+
+		auto& metrics = font->m_face.metrics();
+		font->m_scale = (float)pixel_height / (metrics.ascender - metrics.descender);
+		font->m_asc = (long)ceilf(metrics.ascender * font->m_scale);
+		font->m_desc = pixel_height - font->m_asc;
+		font->m_gap = metrics.line_gap > 0 ? (long)(metrics.line_gap * font->m_scale + 0.5f) : 0;
+		return font;
+	}
+
+	long TrueTypeFont::glyph_advance(uint32_t glyph) const
+	{
+		return (long)(m_face.advance(glyph) * m_scale + 0.5f);
+	}
+
+	long TrueTypeFont::advance(uint32_t code_point) const
+	{
+		return m_advances.get(code_point, [this](uint32_t first, int count, int32_t* out)
+		{
+			for (int i = 0; i < count; ++i)
+				out[i] = glyph_advance(m_face.glyph(first + i));
+		});
+	}
+
+	TrueTypeFont::bitmap_ptr TrueTypeFont::bitmap(uint32_t glyph) const
+	{
+		auto found = m_bitmaps.find(glyph);
+		if (found)
+			return found;
+
+		auto drawn = rasterize(glyph);
+		return m_bitmaps.get(glyph, [&]{ return drawn; });
+	}
+
+	// the outline's box, rounded out to whole pixels, becomes the bitmap
+	TrueTypeFont::bitmap_ptr TrueTypeFont::rasterize(uint32_t glyph) const
+	{
+		auto started = RasterCounters::clock::now();
+
+		auto out = std::make_shared<Bitmap>();
+		out->width = out->height = out->x = out->y = 0;
+
+		TrueType::Box box;
+		if (!m_face.box(glyph, box))
+			return out;
+
+		out->x = (int)floorf(box.x_min * m_scale);
+		out->y = (int)floorf(-box.y_max * m_scale);
+		out->width = (int)ceilf(box.x_max * m_scale) - out->x;
+		out->height = (int)ceilf(-box.y_min * m_scale) - out->y;
+
+		Raster raster(out->width, out->height);
+		TrueType::Transform transform = { m_scale, 0, 0, -m_scale, (float)-out->x, (float)-out->y };
+		m_face.outline(glyph, transform, raster);
+
+		out->coverage.resize(out->width * out->height);
+		raster.coverage(out->coverage.data(), out->width);
+
+		m_counters.add(RasterCounters::clock::now() - started, out->coverage.size());
+		return out;
+	}
+
+	void TrueTypeFont::paint(const std::string& utf8, int x, int y, uint32_t color, Canvas* canvas) const
+	{
+		color |= 0xFF000000;
+
+		auto cr = x;
+		y += m_asc;
+
+		for (auto code_point : utf8::view(utf8))
+		{
+			if (code_point == '\n')
+			{
+				x = cr;
+				y += line_height();
+				continue;
+			}
+
+			uint32_t glyph = m_face.glyph(code_point);
+			auto drawn = bitmap(glyph);
+			if (drawn->width && drawn->height)
+				canvas->fill_mask(x + drawn->x, y + drawn->y, AlphaMask(drawn->coverage.data(), drawn->width, drawn->height), color);
+
+			x += glyph_advance(glyph);
+		}
+	}
+
+	// Items in order, like paint(), but every code point below 0x80 is
+	// resolved once per batch: its cmap lookup, cache find and advance are
+	// shared by all the strings.
+	void TrueTypeFont::paint_batch(const TextItem* items, size_t count, Canvas* canvas) const
+	{
+		struct Resolved
+		{
+			const Bitmap* drawn;
+			long advance;
+		};
+
+		Resolved ascii[0x80] = {};
+		std::vector<bitmap_ptr> held; // keeps the resolved bitmaps alive
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			auto& item = items[i];
+			if (culled(item, *canvas))
+				continue;
+
+			int x = item.x;
+			int y = item.y + m_asc;
+			uint32_t color = item.color | 0xFF000000;
+
+			for (auto code_point : utf8::view(*item.utf8))
+			{
+				if (code_point == '\n')
+				{
+					x = item.x;
+					y += line_height();
+					continue;
+				}
+
+				Resolved resolved;
+				bitmap_ptr drawn; // alive until painted, for code points not kept in ascii
+				if (code_point < 0x80 && ascii[code_point].drawn)
+				{
+					resolved = ascii[code_point];
+				}
+				else
+				{
+					uint32_t glyph = m_face.glyph(code_point);
+					drawn = bitmap(glyph);
+					resolved.drawn = drawn.get();
+					resolved.advance = glyph_advance(glyph);
+					if (code_point < 0x80)
+					{
+						ascii[code_point] = resolved;
+						held.push_back(drawn);
+					}
+				}
+
+				const Bitmap* ink = resolved.drawn;
+				if (ink->width && ink->height)
+					canvas->fill_mask(x + ink->x, y + ink->y, AlphaMask(ink->coverage.data(), ink->width, ink->height), color);
+				x += resolved.advance;
+			}
+		}
+	}
+
+	std::tuple<size_t, size_t> TrueTypeFont::textSize(const std::string& utf8) const
+	{
+		size_t width = 0;
+		size_t lines = 1;
+		long line = 0;
+
+		for (auto code_point : utf8::view(utf8))
+		{
+			if (code_point == '\n')
+			{
+				if ((long)width < line)
+					width = line;
+				line = 0;
+				++lines;
+				continue;
+			}
+
+			line += advance(code_point);
+		}
+
+		if ((long)width < line)
+			width = line;
+
+		return std::make_tuple(width, lines * height() + (lines - 1) * m_gap);
+	}
+
+	ptr truetype(const void* data, size_t size, int pixel_height)
+	{
+		return TrueTypeFont::load((const uint8_t*)data, size, pixel_height, nullptr);
+	}
+
+	ptr truetype(const std::string& path, int pixel_height)
+	{
+		auto mapping = std::make_shared<Mapping>();
+		if (!mapping->open(path))
+			return nullptr;
+
+		return TrueTypeFont::load(mapping->data(), mapping->size(), pixel_height, mapping);
+	}
+}} // gfx::font
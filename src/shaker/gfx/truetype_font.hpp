@@ -0,0 +1,76 @@
+#ifndef __GFX_TRUETYPE_FONT_HPP__
+#define __GFX_TRUETYPE_FONT_HPP__
+
+#include <shaker/gfx/font.hpp>
+#include "advance_table.hpp"
+#include "glyph_cache.hpp"
+#include "raster.hpp"
+#include "truetype.hpp"
+#include <memory>
+#include <vector>
+
+namespace gfx
+{
+	namespace font
+	{
+		// TrueType outlines drawn without the platform's font engine.
+		//
+		// A font is one pixel size, so its cache holds each (glyph, size)
+		// bitmap once. Glyphs are rasterized outside of the cache lock and
+		// the parsed tables are read only, so several threads painting or
+		// measuring with the same font rasterize in parallel; two threads
+		// missing the same glyph at once both draw it and the first one kept
+		// wins.
+		class TrueTypeFont : public Font
+		{
+		public:
+			enum { CACHE_BYTES = 1024 * 1024 };
+
+			// keeps the memory alive, e.g. a file mapping
+			typedef std::shared_ptr<const void> owner_ptr;
+
+			static std::shared_ptr<TrueTypeFont> load(const uint8_t* data, size_t size, int pixel_height, const owner_ptr& owner);
+
+			long height() const override { return m_asc + m_desc; }
+			long asc() const override { return m_asc; }
+			long desc() const override { return m_desc; }
+			long line_height() const override { return m_asc + m_desc + m_gap; }
+			void paint(const std::string& utf8, int x, int y, uint32_t color, Canvas* canvas) const override;
+			std::tuple<size_t, size_t> textSize(const std::string& utf8) const override;
+			long advance(uint32_t code_point) const override;
+			void paint_batch(const TextItem* items, size_t count, Canvas* canvas) const override;
+
+			int pixel_height() const { return m_pixel_height; }
+			void cache_limit(size_t bytes) { m_bitmaps.limit(bytes); }
+			CacheStats cache_stats() const { return m_bitmaps.stats(); }
+			RasterStats raster_stats() const { return m_counters.stats(); }
+
+		private:
+			struct Bitmap
+			{
+				std::vector<uint8_t> coverage;
+				int width, height;
+				int x, y;   // top-left corner relative to the pen on the baseline
+				size_t footprint() const { return sizeof(*this) + coverage.capacity(); }
+			};
+			typedef std::shared_ptr<Bitmap> bitmap_ptr;
+
+			TrueTypeFont(const owner_ptr& owner, int pixel_height);
+
+			bitmap_ptr bitmap(uint32_t glyph) const;
+			bitmap_ptr rasterize(uint32_t glyph) const;
+			long glyph_advance(uint32_t glyph) const;
+
+			owner_ptr m_owner;
+			TrueType m_face;
+			int m_pixel_height;
+			float m_scale;
+			long m_asc, m_desc, m_gap;
+			AdvanceTable m_advances;  // in pixels
+			mutable GlyphCache<Bitmap> m_bitmaps;
+			mutable RasterCounters m_counters;
+		};
+	}
+}
+
+#endif // __GFX_TRUETYPE_FONT_HPP__
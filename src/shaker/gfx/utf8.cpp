@@ -0,0 +1,151 @@
+#include <shaker/gfx/utf8.hpp>
+#include "simd.hpp"
+
+#if GFX_SSE2 && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace utf8
+{
+	namespace
+	{
+#if GFX_SSE2
+		inline int trailing_zeros(int mask)
+		{
+#ifdef _MSC_VER
+			unsigned long index;
+			_BitScanForward(&index, (unsigned long)mask);
+			return (int)index;
+#else
+			return __builtin_ctz((unsigned)mask);
+#endif
+		}
+
+		// the ASCII bytes at the start of the next 16, widened to units;
+		// 16 if they all are
+		template <typename unit>
+		inline int widen(const char* cur, unit* out)
+		{
+			__m128i bytes = gfx::simd::load16(cur);
+			__m128i zero = _mm_setzero_si128();
+			__m128i lo = _mm_unpacklo_epi8(bytes, zero);
+			__m128i hi = _mm_unpackhi_epi8(bytes, zero);
+			if (sizeof(unit) == 2)
+			{
+				_mm_storeu_si128((__m128i*)out, lo);
+				_mm_storeu_si128((__m128i*)out + 1, hi);
+			}
+			else
+			{
+				_mm_storeu_si128((__m128i*)out, _mm_unpacklo_epi16(lo, zero));
+				_mm_storeu_si128((__m128i*)out + 1, _mm_unpackhi_epi16(lo, zero));
+				_mm_storeu_si128((__m128i*)out + 2, _mm_unpacklo_epi16(hi, zero));
+				_mm_storeu_si128((__m128i*)out + 3, _mm_unpackhi_epi16(hi, zero));
+			}
+
+			int high = _mm_movemask_epi8(bytes);
+			return high ? trailing_zeros(high) : 16;
+		}
+#endif
+
+		template <typename unit>
+		size_t transcode(const char* begin, const char* end, unit* out)
+		{
+			unit* start = out;
+			const char* cur = begin;
+
+			while (cur != end)
+			{
+#if GFX_SSE2
+				// no sequence writes more units than it has bytes, so the
+				// 16 units fit whenever 16 bytes are left
+				if (end - cur >= 16)
+				{
+					int ascii = widen(cur, out);
+					cur += ascii;
+					out += ascii;
+					if (ascii == 16)
+						continue;
+				}
+#endif
+				uint8_t lead = impl::mask8(*cur);
+				if (lead < 0x80)
+				{
+					*out++ = (unit)lead;
+					++cur;
+					continue;
+				}
+
+				uint32_t code_point;
+				if (!impl::next(cur, end, code_point))
+				{
+					code_point = UCS_REPLACEMENT;
+					++cur;
+				}
+
+				if (code_point >= 0x10000 && code_point <= 0x10FFFF)
+				{
+					code_point -= 0x10000;
+					*out++ = (unit)(0xD800 + (code_point >> 10));
+					*out++ = (unit)(0xDC00 + (code_point & 0x3FF));
+					continue;
+				}
+
+				if (code_point > 0x10FFFF || (code_point >= 0xD800 && code_point <= 0xDFFF))
+					code_point = UCS_REPLACEMENT;
+				*out++ = (unit)code_point;
+			}
+
+			return out - start;
+		}
+	}
+
+	size_t to16(const char* begin, const char* end, uint16_t* out)
+	{
+		return transcode(begin, end, out);
+	}
+
+	size_t to16(const char* begin, const char* end, wchar_t* out)
+	{
+		return transcode(begin, end, out);
+	}
+
+	size_t decode(const char* begin, const char* end, uint32_t* out)
+	{
+		uint32_t* start = out;
+		const char* cur = begin;
+
+		while (cur != end)
+		{
+#if GFX_SSE2
+			// every byte read so far wrote at most one code point, so there
+			// is room for 16 more
+			if (end - cur >= 16)
+			{
+				int ascii = widen(cur, out);
+				cur += ascii;
+				out += ascii;
+				if (ascii == 16)
+					continue;
+			}
+#endif
+			uint8_t lead = impl::mask8(*cur);
+			if (lead < 0x80)
+			{
+				*out++ = lead;
+				++cur;
+				continue;
+			}
+
+			uint32_t code_point;
+			if (!impl::next(cur, end, code_point))
+			{
+				code_point = UCS_REPLACEMENT;
+				++cur;
+			}
+			*out++ = code_point;
+		}
+
+		return out - start;
+	}
+}
@@ -0,0 +1,259 @@
+#include <shaker/gfx/video.hpp>
+#include <string.h>
+
+namespace gfx { namespace video
+{
+	Pipeline::Input::Input(const Settings& settings)
+		: frame(yuv::Frame(settings.layout, settings.width, settings.height, yuv::Plane()))
+		, buffer(yuv::Frame::packed_size(settings.layout, settings.width, settings.height))
+		, state(FREE)
+		, sequence(0)
+		, timestamp(0)
+	{
+		frame = yuv::Frame::packed(settings.layout, settings.width, settings.height, buffer.data());
+		frame.matrix = settings.matrix;
+		frame.range = settings.range;
+	}
+
+	Pipeline::Pipeline(const Settings& settings)
+		: m_stop(false)
+		, m_sequence(0)
+		, m_presented(0)
+	{
+		memset(&m_stats, 0, sizeof(m_stats));
+
+		for (int i = 0; i < settings.queue_depth; ++i)
+			m_inputs.push_back(std::unique_ptr<Input>(new Input(settings)));
+
+		for (int i = 0; i < settings.surfaces; ++i)
+		{
+			std::unique_ptr<Output> out(new Output);
+			out->surface.pixels.resize(settings.width * settings.height);
+			out->surface.width = settings.width;
+			out->surface.height = settings.height;
+			out->surface.timestamp = 0;
+			out->state = FREE;
+			out->sequence = 0;
+			m_outputs.push_back(std::move(out));
+		}
+
+		for (int i = 0; i < settings.workers; ++i)
+			m_workers.push_back(std::thread([this]{ work(); }));
+	}
+
+	Pipeline::~Pipeline()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m);
+			m_stop = true;
+		}
+		m_work.notify_all();
+
+		for (auto&& worker : m_workers)
+			worker.join();
+	}
+
+	yuv::Frame* Pipeline::acquire()
+	{
+		std::lock_guard<std::mutex> lock(m);
+
+		for (auto&& in : m_inputs)
+		{
+			if (in->state == FREE)
+			{
+				in->state = ACQUIRED;
+				return &in->frame;
+			}
+		}
+
+		auto in = oldest(QUEUED);
+		if (!in)
+			return nullptr;
+
+		++m_stats.dropped_queued;
+		in->state = ACQUIRED;
+		return &in->frame;
+	}
+
+	void Pipeline::submit(yuv::Frame* frame, int64_t timestamp)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m);
+			auto in = input(frame);
+			if (!in || in->state != ACQUIRED)
+				return;
+
+			in->state = QUEUED;
+			in->sequence = ++m_sequence;
+			in->timestamp = timestamp;
+			in->submitted = clock::now();
+			++m_stats.submitted;
+		}
+		m_work.notify_one();
+	}
+
+	void Pipeline::discard(yuv::Frame* frame)
+	{
+		std::lock_guard<std::mutex> lock(m);
+		auto in = input(frame);
+		if (in && in->state == ACQUIRED)
+			in->state = FREE;
+	}
+
+	const Pipeline::Surface* Pipeline::take()
+	{
+		std::unique_lock<std::mutex> lock(m);
+
+		Output* newest = nullptr;
+		for (auto&& out : m_outputs)
+		{
+			if (out->state == READY && (!newest || newest->sequence < out->sequence))
+				newest = out.get();
+		}
+
+		if (!newest)
+			return nullptr;
+
+		bool freed = false;
+		for (auto&& out : m_outputs)
+		{
+			if (out->state == READY && out.get() != newest)
+			{
+				out->state = FREE;
+				++m_stats.dropped_ready;
+				freed = true;
+			}
+		}
+
+		newest->state = TAKEN;
+		m_presented = newest->sequence;
+		++m_stats.presented;
+		measure(m_stats.present, clock::now() - newest->converted);
+
+		lock.unlock();
+		if (freed)
+			m_work.notify_all();
+
+		return &newest->surface;
+	}
+
+	void Pipeline::release(const Surface* surface)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m);
+			for (auto&& out : m_outputs)
+			{
+				if (&out->surface == surface && out->state == TAKEN)
+					out->state = FREE;
+			}
+		}
+		m_work.notify_all();
+	}
+
+	Stats Pipeline::stats() const
+	{
+		std::lock_guard<std::mutex> lock(m);
+
+		Stats out = m_stats;
+		out.queued = out.converting = out.ready = 0;
+		for (auto&& in : m_inputs)
+		{
+			if (in->state == QUEUED) ++out.queued;
+			else if (in->state == BUSY) ++out.converting;
+		}
+		for (auto&& surface : m_outputs)
+		{
+			if (surface->state == READY) ++out.ready;
+		}
+		return out;
+	}
+
+	Pipeline::Input* Pipeline::input(const yuv::Frame* frame)
+	{
+		for (auto&& in : m_inputs)
+		{
+			if (&in->frame == frame)
+				return in.get();
+		}
+		return nullptr;
+	}
+
+	Pipeline::Input* Pipeline::oldest(State state)
+	{
+		Input* found = nullptr;
+		for (auto&& in : m_inputs)
+		{
+			if (in->state == state && (!found || in->sequence < found->sequence))
+				found = in.get();
+		}
+		return found;
+	}
+
+	// a free surface, or the oldest ready one when the presenter is behind
+	Pipeline::Output* Pipeline::output()
+	{
+		Output* ready = nullptr;
+		for (auto&& out : m_outputs)
+		{
+			if (out->state == FREE)
+				return out.get();
+			if (out->state == READY && (!ready || out->sequence < ready->sequence))
+				ready = out.get();
+		}
+		return ready;
+	}
+
+	void Pipeline::work()
+	{
+		std::unique_lock<std::mutex> lock(m);
+		for (;;)
+		{
+			m_work.wait(lock, [this]{ return m_stop || (oldest(QUEUED) && output()); });
+			if (m_stop)
+				return;
+
+			auto in = oldest(QUEUED);
+			auto out = output();
+			if (out->state == READY)
+				++m_stats.dropped_ready;
+
+			in->state = BUSY;
+			out->state = BUSY;
+
+			auto started = clock::now();
+			measure(m_stats.queue, started - in->submitted);
+
+			lock.unlock();
+			yuv::convert(in->frame, out->surface.pixels.data(), out->surface.width);
+			lock.lock();
+
+			out->converted = clock::now();
+			measure(m_stats.convert, out->converted - started);
+			out->surface.timestamp = in->timestamp;
+			out->sequence = in->sequence;
+			in->state = FREE;
+
+			// a newer frame has been presented while this one was converting
+			if (out->sequence < m_presented)
+			{
+				out->state = FREE;
+				++m_stats.dropped_ready;
+			}
+			else
+			{
+				out->state = READY;
+			}
+
+			m_work.notify_all();
+		}
+	}
+
+	void Pipeline::measure(Latency& latency, clock::duration elapsed)
+	{
+		auto us = (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+		latency.last_us = us;
+		latency.average_us = latency.average_us ? (latency.average_us * 15 + us) / 16 : us;
+		if (latency.max_us < us)
+			latency.max_us = us;
+	}
+}} // gfx::video
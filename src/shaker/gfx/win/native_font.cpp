@@ -1,6 +1,8 @@
 #include "native_font.hpp"
-#include <shaker/gfx/palette_bitmap.hpp>
+#include <shaker/gfx/alpha_mask.hpp>
 #include <shaker/gfx/utf8.hpp>
+#include <algorithm>
+#include <string.h>
 
 namespace std
 {
@@ -32,54 +34,6 @@ namespace gfx { namespace font {
 
 		gdi_ptr gdi_font(const std::string& family_name, int size, bool bold, bool italic);
 
-		glyph_word point2indices(HDC dc, const std::ustring& code_points)
-		{
-			std::wstring copy;
-			copy.reserve(code_points.length() + 1);
-			for (auto& cp : code_points)
-				copy.push_back(cp);
-			copy.push_back(0);
-
-			std::vector<wchar_t> glyphs;
-			glyphs.resize(copy.size());
-			if (glyphs.size() != copy.size())
-				return{};
-
-			std::vector<UINT> order;
-			order.resize(copy.size());
-			if (order.size() != copy.size())
-				return{};
-
-			std::vector<int> dx;
-			dx.resize(copy.size());
-			if (dx.size() != copy.size())
-				return{};
-
-			auto flags = GetFontLanguageInfo(dc) & FLI_MASK; // GCP_LIGATE?
-			flags |= GCP_LIGATE | GCP_REORDER;
-			GCP_RESULTS results = { sizeof(results) };
-			results.lpOrder = &order[0];
-			results.lpGlyphs = &glyphs[0];
-			results.lpDx = &dx[0];
-			results.nGlyphs = glyphs.size();
-
-			if (!GetCharacterPlacement(dc, copy.c_str(), copy.length(), 0, &results, flags))
-				return{};
-
-			while (results.nGlyphs && !results.lpGlyphs[results.nGlyphs - 1])
-				--results.nGlyphs;
-
-			glyph_word indices;
-			if (results.nGlyphs)
-			{
-				indices.reserve(results.nGlyphs);
-				for (UINT i = 0; i < results.nGlyphs; ++i)
-					indices.push_back({ results.lpGlyphs[results.lpOrder[i]], results.lpDx[results.lpOrder[i]] });
-			}
-
-			return indices;
-		}
-
 		// Note that, for the GGO_GRAYn_BITMAP values, the function retrieves a glyph bitmap
 		// that contains n^2+1 (n squared plus one) levels of gray.
 		uint8_t gray8(uint8_t src)
@@ -89,7 +43,7 @@ namespace gfx { namespace font {
 			return (uint32_t)src * out_max / max;
 		}
 
-		GdiGlyph::GdiGlyph(HDC dc, uint32_t id)
+		GdiGlyph::GdiGlyph(HDC dc, uint32_t id, GlyphAtlas& atlas)
 			: m_glyph_id(id)
 			, m_advance(0)
 			, m_loaded(false)
@@ -109,6 +63,9 @@ namespace gfx { namespace font {
 			m_offset_x = -gm.gmptGlyphOrigin.x;
 			m_offset_y = gm.gmptGlyphOrigin.y;
 
+			if (!size || !m_width || !m_height)
+				return;
+
 			size_t s_stride = size / m_height;
 
 			std::unique_ptr<uint8_t[]> bitmap{ new uint8_t[size] };
@@ -118,62 +75,85 @@ namespace gfx { namespace font {
 			if (GetGlyphOutline(dc, m_glyph_id, GGO_GRAY8_BITMAP | GGO_GLYPH_INDEX, &gm, size, bitmap.get(), &mat2) == GDI_ERROR)
 				return;
 
-			size_t length = m_width * m_height;
-			m_pixmap.resize(length);
-			if (m_pixmap.size() != length)
+			m_region = atlas.allocate(m_width, m_height);
+			if (!m_region.page)
 				return;
 
-			uint8_t* dest = &m_pixmap[0];
-
-			//wchar_t buffer[1024];
-			//swprintf_s(buffer, L"\n%c/%d/U+%x:\noff:<%dx%d> box:<%dx%d> adv:%d\n\n", (wchar_t)m_code_point, m_code_point, m_code_point, -m_offset_x, m_offset_y, m_width, m_height, m_advance);
-			//OutputDebugString(buffer);
-
 			for (int y = 0; y < m_height; ++y)
 			{
 				auto src = bitmap.get() + y * s_stride;
-				auto dst = dest + y * m_width;
-				//std::string line = "|";
+				auto dst = m_region.data() + y * m_region.stride();
 				for (int x = 0; x < m_width; ++x)
-				{
-					//switch (*src / 8)
-					//{
-					//case 0: line += "  "; break;
-					//case 1: line += ".."; break;
-					//case 2: line += "++"; break;
-					//case 3: line += "**"; break;
-					//case 4: line += "BB"; break;
-					//case 5: line += "&&"; break;
-					//case 6: line += "@@"; break;
-					//case 7: line += "%%"; break;
-					//case 8: line += "##"; break;
-					//}
 					*dst++ = gray8(*src++);
-				}
-				//line += "|\n";
-				//OutputDebugStringA(line.c_str());
 			}
 
 			m_loaded = true;
 		}
 
+		GdiGlyph::GdiGlyph(const GdiGlyph& other, GlyphAtlas& atlas)
+			: m_glyph_id(other.m_glyph_id)
+			, m_advance(other.m_advance)
+			, m_loaded(false)
+			, m_width(other.m_width)
+			, m_height(other.m_height)
+			, m_offset_x(other.m_offset_x)
+			, m_offset_y(other.m_offset_y)
+		{
+			if (!other.m_loaded)
+				return;
+
+			m_region = atlas.allocate(m_width, m_height);
+			if (!m_region.page)
+				return;
+
+			for (int y = 0; y < m_height; ++y)
+				memcpy(m_region.data() + y * m_region.stride(), other.m_region.data() + y * other.m_region.stride(), m_width);
+
+			m_loaded = true;
+		}
+
+		GdiGlyph::~GdiGlyph()
+		{
+			GlyphAtlas::release(m_region);
+		}
+
 		GdiFont::GdiFont(HFONT font, const std::string& family_name, int size, bool bold, bool italic)
 			: m_hFont(font)
 			, m_hDC(CreateCompatibleDC(nullptr))
+			, m_raster_dc(CreateCompatibleDC(nullptr))
 			, m_family_name(family_name)
 			, m_size(size)
 			, m_bold(bold)
 			, m_italic(italic)
 			, m_space_adv(-1)
+			, m_atlas(ATLAS_PAGE_SIZE, ATLAS_PAGES)
+			, m_glyphs(GLYPH_CACHE_BYTES)
+			, m_shaped(SHAPE_CACHE_BYTES)
+			, m_policy(WAIT)
+			, m_skipped(0)
+			, m_warming(false)
+			, m_busy(false)
+			, m_stop(false)
 		{
 			SelectObject(m_hDC, m_hFont);
+			SelectObject(m_raster_dc, m_hFont);
 			GetTextMetrics(m_hDC, &m_metrics);
 		}
 
 		GdiFont::~GdiFont()
 		{
+			{
+				std::lock_guard<std::mutex> lock(m_warm_lock);
+				m_stop = true;
+			}
+			m_warm_work.notify_one();
+			if (m_warmer.joinable())
+				m_warmer.join();
+
 			if (m_hDC)
 				DeleteDC(m_hDC);
+			if (m_raster_dc)
+				DeleteDC(m_raster_dc);
 			if (m_hFont)
 				DeleteObject(m_hFont);
 		}
@@ -194,6 +174,35 @@ namespace gfx { namespace font {
 			return m_space_adv;
 		}
 
+		// a whole page of the BMP per GetCharABCWidths call; above it, the
+		// extent of the surrogate pair
+		long GdiFont::advance(uint32_t code_point) const
+		{
+			return m_advances.get(code_point, [this](uint32_t first, int count, int32_t* out)
+			{
+				std::lock_guard<std::mutex> lock(m);
+				if (first > 0xFFFF)
+				{
+					wchar_t pair[2] = { (wchar_t)(0xD800 + ((first - 0x10000) >> 10)), (wchar_t)(0xDC00 + ((first - 0x10000) & 0x3FF)) };
+					SIZE size = {};
+					GetTextExtentPoint32(m_hDC, pair, 2, &size);
+					*out = size.cx;
+					return;
+				}
+
+				ABC abc[AdvanceTable::PAGE_SIZE];
+				if (!GetCharABCWidths(m_hDC, first, first + count - 1, abc))
+				{
+					for (int i = 0; i < count; ++i)
+						out[i] = 0;
+					return;
+				}
+
+				for (int i = 0; i < count; ++i)
+					out[i] = abc[i].abcA + abc[i].abcB + abc[i].abcC;
+			});
+		}
+
 		long GdiFont::adv(uint32_t id)
 		{
 			auto g = glyph(id);
@@ -202,51 +211,266 @@ namespace gfx { namespace font {
 
 		glyph_ptr GdiFont::glyph(uint32_t id)
 		{
-			std::lock_guard<std::mutex> lock(m);
+			// made under the cache's lock, on a DC of its own, so shaping and
+			// metrics go on while a glyph is rasterized
+			auto glyph = m_glyphs.get(id, [this, id]() -> glyph_ptr
+			{
+				auto started = RasterCounters::clock::now();
+				auto out = std::make_shared<GdiGlyph>(m_raster_dc, id, m_atlas);
+				m_counters.add(RasterCounters::clock::now() - started, out->width() * out->height());
+				return out;
+			});
+
+			// the atlas ran out of pages: forget the glyphs of the evicted ones,
+			// then make room by packing the sparse pages
+			if (m_atlas.evicted())
+			{
+				drop(m_atlas.take_evicted());
+				compact();
+			}
 
-			glyph_ptr ret;
-			for (auto&& glyph : cache)
+			return glyph;
+		}
+
+		glyph_ptr GdiFont::ready(uint32_t id, std::vector<uint32_t>& missing)
+		{
+			if (policy() == WAIT)
+				return glyph(id);
+
+			auto found = m_glyphs.find(id);
+			if (!found)
 			{
-				if (glyph->id() == id)
-					return glyph;
+				m_skipped.fetch_add(1, std::memory_order_relaxed);
+				missing.push_back(id);
 			}
+			return found;
+		}
 
-			ret = std::make_shared<GdiGlyph>(m_hDC, id);
-			cache.push_back(ret);
-			return ret;
+		void GdiFont::warm(const std::string& utf8)
+		{
+			std::lock_guard<std::mutex> lock(m_warm_lock);
+			m_warm_texts.push_back(utf8);
+			start_warming();
 		}
 
-		glyph_text GdiFont::indices(const std::ustring& code_points)
+		void GdiFont::warm(const std::vector<uint32_t>& ids)
 		{
-			glyph_text out;
-			glyph_line line;
-			std::ustring word;
+			std::lock_guard<std::mutex> lock(m_warm_lock);
+			for (auto id : ids)
+			{
+				if (m_warm_queued.insert(id).second)
+					m_warm_ids.push_back(id);
+			}
+			start_warming();
+		}
+
+		bool GdiFont::warming()
+		{
+			std::lock_guard<std::mutex> lock(m_warm_lock);
+			return m_busy || !m_warm_texts.empty() || !m_warm_ids.empty();
+		}
 
-			auto cur = code_points.begin(), end = code_points.end();
-			for (auto&& cp : code_points)
+		// m_warm_lock is held; wakes the thread, or starts a new one after
+		// the last one has been idle for too long and quit
+		void GdiFont::start_warming()
+		{
+			if (m_stop)
+				return;
+
+			if (m_warming)
 			{
-				if (cp == ' ')
+				m_warm_work.notify_one();
+				return;
+			}
+
+			if (m_warmer.joinable())
+				m_warmer.join();
+
+			m_warming = true;
+			m_warmer = std::thread([this]{ warm_up(); });
+		}
+
+		// Warming a text only fills the room left in the glyph cache and the
+		// atlas, keeping a page and a quarter of the cache for what is being
+		// painted; glyphs a paint has missed are always rasterized.
+		bool GdiFont::has_room() const
+		{
+			auto stats = m_glyphs.stats();
+			return stats.bytes < stats.limit / 4 * 3 && stats.entries < m_glyphs.max_entries() / 4 * 3
+				&& m_atlas.pages() + 1 < ATLAS_PAGES;
+		}
+
+		void GdiFont::warm_up()
+		{
+			std::vector<uint32_t> ids;
+			for (;;)
+			{
+				std::string text;
+				bool missed = false;
 				{
-					line.push_back(std::move(point2indices(m_hDC, word)));
-					word.clear();
-					continue;
+					std::unique_lock<std::mutex> lock(m_warm_lock);
+					m_busy = false;
+					m_warm_work.wait_for(lock, std::chrono::milliseconds(WARM_IDLE_MS), [this]
+					{
+						return m_stop || !m_warm_texts.empty() || !m_warm_ids.empty();
+					});
+
+					if (m_stop || (m_warm_texts.empty() && m_warm_ids.empty()))
+					{
+						m_warming = false;
+						return;
+					}
+
+					m_busy = true;
+					if (!m_warm_ids.empty())
+					{
+						ids.swap(m_warm_ids);
+						missed = true;
+					}
+					else
+					{
+						text.swap(m_warm_texts.front());
+						m_warm_texts.pop_front();
+					}
 				}
 
-				if (cp == '\n')
+				if (!missed)
+					glyph_ids(text, ids);
+
+				for (auto id : ids)
 				{
-					line.push_back(std::move(point2indices(m_hDC, word)));
-					out.push_back(std::move(line));
-					word.clear();
-					line.clear(); // unneeded?
-					continue;
+					if (!missed && !has_room())
+						break;
+					if (!m_glyphs.find(id))
+						glyph(id);
 				}
 
-				word.push_back(cp);
+				if (missed)
+				{
+					std::lock_guard<std::mutex> lock(m_warm_lock);
+					for (auto id : ids)
+						m_warm_queued.erase(id);
+				}
+				ids.clear();
 			}
+		}
+
+		// the glyphs of the shaped text, without keeping it in the shape cache
+		void GdiFont::glyph_ids(const std::string& utf8, std::vector<uint32_t>& out)
+		{
+			std::lock_guard<std::mutex> lock(m);
+
+			auto& utf16 = m_scratch.text;
+			utf16.resize(utf8.size() + 1);
+			size_t length = utf8::to16(utf8.data(), utf8.data() + utf8.size(), &utf16[0]);
+			indices(&utf16[0], &utf16[0] + length);
 
-			line.push_back(std::move(point2indices(m_hDC, word)));
-			out.push_back(std::move(line));
-			return out;
+			for (auto&& info : m_scratch.run.glyphs)
+			{
+				if (info.kind == GlyphInfo::GLYPH)
+					out.push_back(info.id);
+			}
+		}
+
+		void GdiFont::drop(const std::vector<GlyphAtlas::page_ptr>& pages)
+		{
+			m_glyphs.update([&](const glyph_ptr& glyph) -> glyph_ptr
+			{
+				return std::find(pages.begin(), pages.end(), glyph->page()) == pages.end() ? glyph : nullptr;
+			});
+		}
+
+		void GdiFont::compact()
+		{
+			auto retired = m_atlas.defragment();
+			if (retired.empty())
+				return;
+
+			m_glyphs.update([&](const glyph_ptr& glyph) -> glyph_ptr
+			{
+				if (std::find(retired.begin(), retired.end(), glyph->page()) == retired.end())
+					return glyph;
+				return std::make_shared<GdiGlyph>(*glyph, m_atlas);
+			});
+		}
+
+		// appends the glyphs of one word to the scratch run
+		void GdiFont::shape_word(const wchar_t* begin, const wchar_t* end)
+		{
+			if (begin == end)
+				return;
+
+			UINT length = (UINT)(end - begin);
+			m_scratch.glyphs.resize(length);
+			m_scratch.order.resize(length);
+			m_scratch.dx.resize(length);
+
+			auto flags = GetFontLanguageInfo(m_hDC) & FLI_MASK; // GCP_LIGATE?
+			flags |= GCP_LIGATE | GCP_REORDER;
+			GCP_RESULTS results = { sizeof(results) };
+			results.lpOrder = &m_scratch.order[0];
+			results.lpGlyphs = &m_scratch.glyphs[0];
+			results.lpDx = &m_scratch.dx[0];
+			results.nGlyphs = length;
+
+			if (!GetCharacterPlacement(m_hDC, begin, length, 0, &results, flags))
+				return;
+
+			auto& out = m_scratch.run.glyphs;
+			for (UINT i = 0; i < results.nGlyphs; ++i)
+			{
+				GlyphInfo info = { (uint32_t)results.lpGlyphs[results.lpOrder[i]], results.lpDx[results.lpOrder[i]], GlyphInfo::GLYPH };
+				out.push_back(info);
+			}
+		}
+
+		// shapes the text into the scratch run
+		void GdiFont::indices(const wchar_t* text, const wchar_t* end)
+		{
+			auto& run = m_scratch.run;
+			run.glyphs.clear();
+			run.lines = 1;
+
+			const wchar_t* word = text;
+
+			for (auto cur = text; cur != end; ++cur)
+			{
+				if (*cur != ' ' && *cur != '\n')
+					continue;
+
+				shape_word(word, cur);
+				word = cur + 1;
+
+				GlyphInfo info = { 0, 0, *cur == ' ' ? GlyphInfo::WORD_BREAK : GlyphInfo::LINE_BREAK };
+				run.glyphs.push_back(info);
+				if (*cur == '\n')
+					++run.lines;
+			}
+
+			shape_word(word, end);
+		}
+
+		shaped_ptr GdiFont::shape(const std::string& utf8)
+		{
+			auto text = m_shaped.find(utf8);
+			if (text)
+				return text;
+
+			{
+				std::lock_guard<std::mutex> lock(m);
+
+				// words are shaped straight from the transcoded text
+				auto& utf16 = m_scratch.text;
+				utf16.resize(utf8.size() + 1);
+				size_t length = utf8::to16(utf8.data(), utf8.data() + utf8.size(), &utf16[0]);
+				indices(&utf16[0], &utf16[0] + length);
+
+				// copied out in a single allocation, the scratch keeps its capacity
+				text = std::make_shared<GlyphRun>(m_scratch.run);
+			}
+
+			m_shaped.insert(utf8, text, sizeof(GlyphRun) + text->glyphs.size() * sizeof(GlyphInfo));
+			return text;
 		}
 
 		gdi_ptr Repo::_load(const std::string& family_name, int size, bool bold, bool italic)
@@ -258,7 +482,7 @@ namespace gfx { namespace font {
 
 			for (; cur != end; ++cur)
 			{
-				auto&& ptr = *cur;
+				auto ptr = *cur; // a copy, the erase() below destroys the element
 				if (ptr->family_name() != family_name ||
 					ptr->size() != size ||
 					ptr->isBold() != bold ||
@@ -284,68 +508,174 @@ namespace gfx { namespace font {
 
 		void Font::paint(const std::string& utf8, int x, int y, uint32_t color, Canvas* canvas) const
 		{
-			uint32_t palette[256];
-			color &= 0x00FFFFFF;
-			for (uint32_t alpha = 0; alpha < 0x100; ++alpha)
-				palette[alpha] = color | (alpha << 24);
+			color |= 0xFF000000;
 
 			auto cr = x;
 			auto ascend = rep->asc();
 
 			y += rep->asc();
 
-			auto text = rep->indices(utf8::to32(utf8));
-			for (auto&& line : text)
+			std::vector<uint32_t> missing;
+			auto text = rep->shape(utf8);
+			for (auto&& info : text->glyphs)
+			{
+				if (info.kind == GlyphInfo::WORD_BREAK)
+				{
+					x += rep->space();
+					continue;
+				}
+
+				if (info.kind == GlyphInfo::LINE_BREAK)
+				{
+					y += line_height();
+					x = cr;
+					continue;
+				}
+
+				auto glyph = rep->ready(info.id, missing);
+				if (!glyph)
+				{
+					x += info.dx;
+					continue;
+				}
+
+				if (glyph->loaded())
+				{
+					canvas->fill_mask(
+						x - glyph->offset_x(), y - glyph->offset_y(),
+						glyph->mask(),
+						color
+					);
+				}
+
+				x += info.dx; //glyph->advance();
+			}
+
+			if (!missing.empty())
+				rep->warm(missing);
+		}
+
+		// Every glyph of the visible items is placed first, then looked up
+		// once per distinct glyph and blitted page by page, instead of one
+		// cache lookup and one scattered blit per glyph of every string.
+		void Font::paint_batch(const TextItem* items, size_t count, Canvas* canvas) const
+		{
+			struct Placement
+			{
+				uint32_t id;
+				int x, y;
+				uint32_t color;
+			};
+
+			struct Group
 			{
-				for (auto&& word : line)
+				glyph_ptr glyph;
+				size_t begin, end; // of the placements
+			};
+
+			std::vector<Placement> placements;
+			for (size_t i = 0; i < count; ++i)
+			{
+				auto& item = items[i];
+				if (culled(item, *canvas))
+					continue;
+
+				int x = item.x;
+				int y = item.y + rep->asc();
+				uint32_t color = item.color | 0xFF000000;
+
+				auto text = rep->shape(*item.utf8);
+				for (auto&& info : text->glyphs)
 				{
-					for (auto&& info : word)
+					if (info.kind == GlyphInfo::WORD_BREAK)
 					{
-						auto glyph = rep->glyph(info.id);
-						if (!glyph)
-							continue;
-
-						if (glyph->loaded())
-						{
-							canvas->paint(
-								x - glyph->offset_x(), y - glyph->offset_y(),
-								gfx::PaletteBitmap{ (uint8_t*)glyph->pixmap(), palette, glyph->width(), glyph->height() }
-							);
-						}
-
-						x += info.dx; //glyph->advance();
+						x += rep->space();
+						continue;
 					}
 
-					x += rep->space();
+					if (info.kind == GlyphInfo::LINE_BREAK)
+					{
+						y += line_height();
+						x = item.x;
+						continue;
+					}
+
+					Placement placement = { info.id, x, y, color };
+					placements.push_back(placement);
+					x += info.dx;
+				}
+			}
+
+			// stable, so the copies of one glyph keep the order of the items
+			std::stable_sort(placements.begin(), placements.end(), [](const Placement& lhs, const Placement& rhs)
+			{
+				return lhs.id < rhs.id;
+			});
+
+			std::vector<Group> groups;
+			std::vector<uint32_t> missing;
+			for (size_t begin = 0, end = 0; begin < placements.size(); begin = end)
+			{
+				while (end < placements.size() && placements[end].id == placements[begin].id)
+					++end;
+
+				auto glyph = rep->ready(placements[begin].id, missing);
+				if (glyph && glyph->loaded())
+				{
+					Group group = { glyph, begin, end };
+					groups.push_back(group);
 				}
+			}
 
-				y += line_height();
-				x = cr;
+			if (!missing.empty())
+				rep->warm(missing);
+
+			std::sort(groups.begin(), groups.end(), [](const Group& lhs, const Group& rhs)
+			{
+				return lhs.glyph->page() < rhs.glyph->page();
+			});
+
+			for (auto&& group : groups)
+			{
+				auto& glyph = *group.glyph;
+				auto mask = glyph.mask();
+				for (size_t i = group.begin; i < group.end; ++i)
+				{
+					auto& placement = placements[i];
+					canvas->fill_mask(placement.x - glyph.offset_x(), placement.y - glyph.offset_y(), mask, placement.color);
+				}
 			}
 		}
 
 		std::tuple<size_t, size_t> Font::textSize(const std::string& utf8) const
 		{
 			size_t width = 0;
-			size_t height = 0;
+			size_t length = 0;
 
-			auto text = rep->indices(utf8::to32(utf8));
-			for (auto&& line : text)
+			auto text = rep->shape(utf8);
+			for (auto&& info : text->glyphs)
 			{
-				height++;
-				size_t length = 0;
-				for (auto&& word : line)
+				if (info.kind == GlyphInfo::WORD_BREAK)
 				{
-					for (auto&& glyph : word)
-						length += rep->adv(glyph);
 					length += rep->space();
+					continue;
+				}
+
+				if (info.kind == GlyphInfo::LINE_BREAK)
+				{
+					if (width < length)
+						width = length;
+					length = 0;
+					continue;
 				}
-				length -= rep->space();
 
-				if (width < length)
-					width = length;
+				length += rep->adv(info);
 			}
 
+			if (width < length)
+				width = length;
+
+			size_t height = text->lines;
 			return std::make_tuple( width, height * rep->height() + (height - 1) * rep->interline());
 		}
 
@@ -3,9 +3,19 @@
 
 #include <shaker/gfx/font.hpp>
 #include <shaker/gfx/utf8.hpp>
+#include "../advance_table.hpp"
+#include "../glyph_atlas.hpp"
+#include "../glyph_cache.hpp"
+#include "../lru_cache.hpp"
+#include "../raster.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <memory>
 #include <vector>
 #include <mutex>
+#include <thread>
+#include <unordered_set>
 #include <Windows.h>
 
 namespace gfx
@@ -15,52 +25,129 @@ namespace gfx
 		namespace win
 		{
 			static const size_t CACHE_SIZE = 4;
+			static const size_t GLYPH_CACHE_BYTES = 1024 * 1024; // per font
+			static const int ATLAS_PAGE_SIZE = 256;
+			static const size_t ATLAS_PAGES = 8;                // per font
+			static const size_t SHAPE_CACHE_BYTES = 256 * 1024;  // per font
+			static const int WARM_IDLE_MS = 1000;                // the warm-up thread's wait for more work
 
 			class GdiGlyph
 			{
 				uint32_t m_glyph_id;
 				long m_advance;
 				bool m_loaded;
-				std::vector<uint8_t> m_pixmap;
+				GlyphAtlas::Region m_region;
 				int m_width;
 				int m_height;
 				int m_offset_x;
 				int m_offset_y;
+
+				GdiGlyph(const GdiGlyph&);
+				GdiGlyph& operator=(const GdiGlyph&);
 			public:
-				GdiGlyph(HDC dc, uint32_t id);
+				GdiGlyph(HDC dc, uint32_t id, GlyphAtlas& atlas);
+				GdiGlyph(const GdiGlyph& other, GlyphAtlas& atlas); // moves the pixels to a new region
+				~GdiGlyph();
 				uint32_t id() const { return m_glyph_id; }
 				long advance() const { return m_advance; }
 				bool loaded() const { return m_loaded; }
-				const uint8_t* pixmap() { return m_pixmap.data(); }
+				AlphaMask mask() const { return m_region.mask(); }
+				const GlyphAtlas::page_ptr& page() const { return m_region.page; }
 				int width() const { return m_width; }
 				int height() const { return m_height; }
 				int offset_x() const { return m_offset_x; }
 				int offset_y() const { return m_offset_y; }
+				size_t footprint() const { return sizeof(*this) + m_region.area(); }
 			};
 
 			typedef std::shared_ptr<GdiGlyph> glyph_ptr;
 
 			struct GlyphInfo
 			{
+				enum Kind
+				{
+					GLYPH,
+					WORD_BREAK, // a space between two words
+					LINE_BREAK
+				};
+
 				uint32_t id;
 				int dx;
+				Kind kind;
 			};
-			typedef std::vector<GlyphInfo> glyph_word;
-			typedef std::vector<glyph_word> glyph_line;
-			typedef std::vector<glyph_line> glyph_text;
+
+			// Shaped text in one buffer: the glyphs of each word, with the
+			// spaces and newlines between them kept as break markers.
+			struct GlyphRun
+			{
+				std::vector<GlyphInfo> glyphs;
+				size_t lines;
+
+				GlyphRun() : lines(1) {}
+			};
+			typedef std::shared_ptr<const GlyphRun> shaped_ptr;
 
 			class GdiFont
 			{
-				std::mutex m;
+			public:
+				// what paint does with a glyph that is not rasterized yet
+				enum Policy
+				{
+					WAIT, // rasterizes it, or waits for the background thread doing so
+					SKIP  // leaves it out and queues it for the background thread
+				};
+
+			private:
+				mutable std::mutex m;
 				HFONT m_hFont;
 				HDC m_hDC;
+				HDC m_raster_dc; // used by glyph() alone, which the glyph cache's lock serializes
 				TEXTMETRIC m_metrics;
 				std::string m_family_name;
 				int m_size;
 				bool m_bold;
 				bool m_italic;
 				long m_space_adv;
-				std::vector<glyph_ptr> cache;
+				GlyphAtlas m_atlas;
+				GlyphCache<GdiGlyph> m_glyphs;
+				LruCache<GlyphRun> m_shaped;
+				RasterCounters m_counters;
+				AdvanceTable m_advances;
+				std::atomic<int> m_policy;
+				std::atomic<uint64_t> m_skipped;
+
+				// background rasterization, guarded by m_warm_lock; the thread
+				// runs while there is something queued and a while after
+				std::mutex m_warm_lock;
+				std::condition_variable m_warm_work;
+				std::deque<std::string> m_warm_texts;
+				std::vector<uint32_t> m_warm_ids;
+				std::unordered_set<uint32_t> m_warm_queued; // ids queued or being rasterized
+				std::thread m_warmer;
+				bool m_warming;                             // the thread is running
+				bool m_busy;                                // it has taken work it has not finished
+				bool m_stop;
+
+				// reused by every shaping call, guarded by m
+				struct Scratch
+				{
+					std::vector<wchar_t> text; // UTF-16
+					std::vector<wchar_t> glyphs;
+					std::vector<UINT> order;
+					std::vector<int> dx;
+					GlyphRun run;
+				} m_scratch;
+
+				void drop(const std::vector<GlyphAtlas::page_ptr>& pages);
+				void shape_word(const wchar_t* begin, const wchar_t* end);
+				void indices(const wchar_t* text, const wchar_t* end);
+				void glyph_ids(const std::string& utf8, std::vector<uint32_t>& out);
+				void start_warming();
+				void warm_up();
+				bool has_room() const;
+
+				GdiFont(const GdiFont&);
+				GdiFont& operator=(const GdiFont&);
 			public:
 				GdiFont(HFONT font, const std::string& family_name, int size, bool bold, bool italic);
 				~GdiFont();
@@ -75,8 +162,36 @@ namespace gfx
 				long space();
 				long adv(uint32_t id);
 				long adv(const GlyphInfo& nfo) const { return nfo.dx; }
+				// unshaped, from the ABC widths of the code point
+				long advance(uint32_t code_point) const;
 				glyph_ptr glyph(uint32_t id);
-				glyph_text indices(const std::ustring& code_points);
+				// glyph() or, with SKIP, whatever is cached; the ids of glyphs
+				// left out are added to missing, to be passed to warm()
+				glyph_ptr ready(uint32_t id, std::vector<uint32_t>& missing);
+				void glyph_cache_limit(size_t bytes) { m_glyphs.limit(bytes); }
+				CacheStats glyph_cache_stats() const { return m_glyphs.stats(); }
+				RasterStats raster_stats() const { return m_counters.stats(); }
+
+				void policy(Policy policy) { m_policy.store(policy, std::memory_order_relaxed); }
+				Policy policy() const { return (Policy)m_policy.load(std::memory_order_relaxed); }
+				// Rasterizes the glyphs of utf8 on a background thread, e.g. a
+				// character set or sample strings before they are first shown.
+				// Stops early rather than evict cached glyphs for them.
+				void warm(const std::string& utf8);
+				// glyphs a paint left out, rasterized whatever the cache holds
+				void warm(const std::vector<uint32_t>& ids);
+				// true while the background thread has glyphs left; with SKIP,
+				// text painted meanwhile should be painted again afterwards
+				bool warming();
+				// glyphs left out by paints so far
+				uint64_t skipped() const { return m_skipped.load(std::memory_order_relaxed); }
+
+				// moves glyphs off atlas pages that are mostly empty
+				void compact();
+				// the shaped string, shared by every measure and paint of it
+				shaped_ptr shape(const std::string& utf8);
+				void shape_cache_limit(size_t bytes) { m_shaped.limit(bytes); }
+				CacheStats shape_cache_stats() const { return m_shaped.stats(); }
 			};
 
 			typedef std::shared_ptr<GdiFont> gdi_ptr;
@@ -98,6 +213,15 @@ namespace gfx
 				{
 					return repo()._load(family_name, size, bold, italic);
 				}
+
+				// loads the font into the repository and starts rasterizing the
+				// glyphs of utf8, e.g. for the configured fonts while the plugin
+				// starts; the repository keeps the CACHE_SIZE most recent fonts,
+				// and each font warms up only as much as its caches hold
+				static void warm(const std::string& family_name, int size, bool bold, bool italic, const std::string& utf8)
+				{
+					load(family_name, size, bold, italic)->warm(utf8);
+				}
 			};
 
 			class Font : public font::Font
@@ -111,6 +235,9 @@ namespace gfx
 				long line_height() const override { return rep->height() + rep->interline(); }
 				void paint(const std::string& utf8, int x, int y, uint32_t color, Canvas* canvas) const override;
 				std::tuple<size_t, size_t> textSize(const std::string& utf8) const override;
+				long advance(uint32_t code_point) const override { return rep->advance(code_point); }
+				void paint_batch(const TextItem* items, size_t count, Canvas* canvas) const override;
+				uint64_t skipped_glyphs() const override { return rep->skipped(); }
 			};
 		}
 	}
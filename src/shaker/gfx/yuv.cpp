@@ -0,0 +1,523 @@
+#include <shaker/gfx/yuv.hpp>
+#include <shaker/gfx/basic.hpp>
+#include <shaker/gfx/canvas.hpp>
+#include "simd.hpp"
+#include <vector>
+
+namespace gfx { namespace yuv
+{
+	namespace
+	{
+		inline uint32_t pack(uint8_t first, uint8_t second, uint8_t third)
+		{
+			return 0xFF000000 | (third << 16) | (second << 8) | first;
+		}
+
+		template <typename C>
+		inline uint32_t pixel(int y, int u, int v, bool bgra)
+		{
+			y = (y - C::Y_OFFSET) * C::Y_MUL + 128;
+			u -= 128;
+			v -= 128;
+
+			uint8_t r = clamp((y + C::V_TO_R * v) >> 8);
+			uint8_t g = clamp((y - C::U_TO_G * u - C::V_TO_G * v) >> 8);
+			uint8_t b = clamp((y + C::U_TO_B * u) >> 8);
+
+			return bgra ? pack(b, g, r) : pack(r, g, b);
+		}
+
+		// Row pointers for one output line. The scalar path reads
+		// Y[x * Y_STEP], U[(x >> H_SHIFT) * C_STEP] and V[(x >> H_SHIFT) * C_STEP].
+		struct Rows
+		{
+			const uint8_t* Y;
+			const uint8_t* U;
+			const uint8_t* V;
+		};
+
+#if GFX_SSE2
+		// 8 pixels of 16-bit y, u, v to 8 native-order pixels
+		template <typename C>
+		inline void store8(uint32_t* out, __m128i y, __m128i u, __m128i v, bool bgra)
+		{
+			const __m128i round = _mm_set1_epi32(128);
+			y = _mm_sub_epi16(y, _mm_set1_epi16(C::Y_OFFSET));
+			u = _mm_sub_epi16(u, _mm_set1_epi16(128));
+			v = _mm_sub_epi16(v, _mm_set1_epi16(128));
+
+			__m128i zero = _mm_setzero_si128();
+			__m128i yu_lo = _mm_unpacklo_epi16(y, u), yu_hi = _mm_unpackhi_epi16(y, u);
+			__m128i yv_lo = _mm_unpacklo_epi16(y, v), yv_hi = _mm_unpackhi_epi16(y, v);
+			__m128i v_lo = _mm_unpacklo_epi16(v, zero), v_hi = _mm_unpackhi_epi16(v, zero);
+
+			__m128i k_r = simd::pair16(C::Y_MUL, C::V_TO_R);
+			__m128i k_g = simd::pair16(C::Y_MUL, -C::U_TO_G);
+			__m128i k_gv = simd::pair16(-C::V_TO_G, 0);
+			__m128i k_b = simd::pair16(C::Y_MUL, C::U_TO_B);
+
+#define YUV_CHANNEL(lo, hi) _mm_packs_epi32(_mm_srai_epi32(_mm_add_epi32(lo, round), 8), _mm_srai_epi32(_mm_add_epi32(hi, round), 8))
+			__m128i r = YUV_CHANNEL(_mm_madd_epi16(yv_lo, k_r), _mm_madd_epi16(yv_hi, k_r));
+			__m128i g = YUV_CHANNEL(
+				_mm_add_epi32(_mm_madd_epi16(yu_lo, k_g), _mm_madd_epi16(v_lo, k_gv)),
+				_mm_add_epi32(_mm_madd_epi16(yu_hi, k_g), _mm_madd_epi16(v_hi, k_gv)));
+			__m128i b = YUV_CHANNEL(_mm_madd_epi16(yu_lo, k_b), _mm_madd_epi16(yu_hi, k_b));
+#undef YUV_CHANNEL
+
+			r = _mm_packus_epi16(r, r);
+			g = _mm_packus_epi16(g, g);
+			b = _mm_packus_epi16(b, b);
+
+			__m128i first_second = _mm_unpacklo_epi8(bgra ? b : r, g);
+			__m128i third_alpha = _mm_unpacklo_epi8(bgra ? r : b, _mm_set1_epi8((char)0xFF));
+			_mm_storeu_si128((__m128i*)out, _mm_unpacklo_epi16(first_second, third_alpha));
+			_mm_storeu_si128((__m128i*)(out + 4), _mm_unpackhi_epi16(first_second, third_alpha));
+		}
+
+		inline __m128i widen(__m128i bytes) { return _mm_unpacklo_epi8(bytes, _mm_setzero_si128()); }
+		inline __m128i twice(__m128i words) { return _mm_unpacklo_epi16(words, words); }
+#endif
+
+		template <Layout L> struct Traits;
+
+		// I420 and I422 only differ in the vertical chroma shift
+		template <int V_SHIFT_>
+		struct PlanarHalf
+		{
+			enum { Y_STEP = 1, H_SHIFT = 1, V_SHIFT = V_SHIFT_, C_STEP = 1 };
+
+			static Rows rows(const Frame& f, int row, int crow)
+			{
+				Rows out = {
+					f.planes[0].data + row * f.planes[0].stride,
+					f.planes[1].data + crow * f.planes[1].stride,
+					f.planes[2].data + crow * f.planes[2].stride
+				};
+				return out;
+			}
+
+#if GFX_SSE2
+			// x must be even
+			static void fetch8(const Rows& r, int x, __m128i& y, __m128i& u, __m128i& v)
+			{
+				y = widen(simd::load8(r.Y + x));
+				u = twice(widen(simd::load4(r.U + (x >> 1))));
+				v = twice(widen(simd::load4(r.V + (x >> 1))));
+			}
+#endif
+		};
+
+		template <> struct Traits<I420> : PlanarHalf<1> {};
+		template <> struct Traits<I422> : PlanarHalf<0> {};
+
+		template <>
+		struct Traits<I444>
+		{
+			enum { Y_STEP = 1, H_SHIFT = 0, V_SHIFT = 0, C_STEP = 1 };
+
+			static Rows rows(const Frame& f, int row, int crow)
+			{
+				Rows out = {
+					f.planes[0].data + row * f.planes[0].stride,
+					f.planes[1].data + crow * f.planes[1].stride,
+					f.planes[2].data + crow * f.planes[2].stride
+				};
+				return out;
+			}
+
+#if GFX_SSE2
+			static void fetch8(const Rows& r, int x, __m128i& y, __m128i& u, __m128i& v)
+			{
+				y = widen(simd::load8(r.Y + x));
+				u = widen(simd::load8(r.U + x));
+				v = widen(simd::load8(r.V + x));
+			}
+#endif
+		};
+
+		// NV12 and NV21 only differ in which byte of the chroma pair is U
+		template <bool UFirst>
+		struct SemiPlanar
+		{
+			enum { Y_STEP = 1, H_SHIFT = 1, V_SHIFT = 1, C_STEP = 2 };
+
+			static Rows rows(const Frame& f, int row, int crow)
+			{
+				const uint8_t* chroma = f.planes[1].data + crow * f.planes[1].stride;
+				Rows out = {
+					f.planes[0].data + row * f.planes[0].stride,
+					UFirst ? chroma : chroma + 1,
+					UFirst ? chroma + 1 : chroma
+				};
+				return out;
+			}
+
+#if GFX_SSE2
+			// x must be even
+			static void fetch8(const Rows& r, int x, __m128i& y, __m128i& u, __m128i& v)
+			{
+				y = widen(simd::load8(r.Y + x));
+				__m128i pairs = simd::load8((UFirst ? r.U : r.V) + x); // 4 chroma pairs as 16-bit
+				__m128i lo = _mm_and_si128(pairs, _mm_set1_epi16(0xFF));
+				__m128i hi = _mm_srli_epi16(pairs, 8);
+				u = twice(UFirst ? lo : hi);
+				v = twice(UFirst ? hi : lo);
+			}
+#endif
+		};
+
+		template <> struct Traits<NV12> : SemiPlanar<true> {};
+		template <> struct Traits<NV21> : SemiPlanar<false> {};
+
+		template <>
+		struct Traits<YUY2>
+		{
+			enum { Y_STEP = 2, H_SHIFT = 1, V_SHIFT = 0, C_STEP = 4 };
+
+			static Rows rows(const Frame& f, int row, int crow)
+			{
+				const uint8_t* line = f.planes[0].data + row * f.planes[0].stride;
+				const uint8_t* chroma = f.planes[0].data + crow * f.planes[0].stride;
+				Rows out = { line, chroma + 1, chroma + 3 };
+				return out;
+			}
+
+#if GFX_SSE2
+			// x must be even
+			static void fetch8(const Rows& r, int x, __m128i& y, __m128i& u, __m128i& v)
+			{
+				__m128i quads = simd::load16(r.Y + (x << 1));
+				y = _mm_and_si128(quads, _mm_set1_epi16(0xFF));
+				__m128i chroma = _mm_srli_epi16(quads, 8); // U0 V0 U1 V1 ... as 16-bit
+				u = _mm_and_si128(chroma, _mm_set1_epi32(0xFFFF));
+				u = _mm_or_si128(u, _mm_slli_epi32(u, 16));
+				v = _mm_srli_epi32(chroma, 16);
+				v = _mm_or_si128(v, _mm_slli_epi32(v, 16));
+			}
+#endif
+		};
+
+		template <Layout L, typename C>
+		void convert_row(const Rows& rows, uint32_t* out, int width, bool bgra)
+		{
+			typedef Traits<L> T;
+
+			int x = 0;
+#if GFX_SSE2
+			for (; x + 8 <= width; x += 8)
+			{
+				__m128i y, u, v;
+				T::fetch8(rows, x, y, u, v);
+				store8<C>(out + x, y, u, v, bgra);
+			}
+#endif
+			for (; x < width; ++x)
+			{
+				int c = (x >> T::H_SHIFT) * T::C_STEP;
+				out[x] = pixel<C>(rows.Y[x * T::Y_STEP], rows.U[c], rows.V[c], bgra);
+			}
+		}
+
+		// converts width pixels of a row, starting at column x of the frame;
+		// an odd x on subsampled chroma takes one scalar pixel to get back in phase
+		template <Layout L, typename C>
+		void convert_span(Rows rows, int x, uint32_t* out, int width, bool bgra)
+		{
+			typedef Traits<L> T;
+
+			rows.Y += x * T::Y_STEP;
+			rows.U += (x >> T::H_SHIFT) * T::C_STEP;
+			rows.V += (x >> T::H_SHIFT) * T::C_STEP;
+
+			if (T::H_SHIFT && (x & 1) && width)
+			{
+				*out++ = pixel<C>(*rows.Y, *rows.U, *rows.V, bgra);
+				rows.Y += T::Y_STEP;
+				rows.U += T::C_STEP;
+				rows.V += T::C_STEP;
+				--width;
+			}
+
+			convert_row<L, C>(rows, out, width, bgra);
+		}
+
+		template <Layout L, typename C>
+		void convert_frame(const Frame& frame, const Rect& crop, uint8_t* out, int out_stride, bool bgra)
+		{
+			for (int row = 0; row < crop.height; ++row)
+			{
+				int y = crop.y + row;
+				convert_span<L, C>(Traits<L>::rows(frame, y, y >> Traits<L>::V_SHIFT), crop.x, (uint32_t*)(out + row * out_stride), crop.width, bgra);
+			}
+		}
+
+		// One resampling tap: index of the first sample and 8-bit weight of the next one
+		struct Tap
+		{
+			int index;
+			int weight;
+		};
+
+		// Maps dst_len pixel centers onto src_len luma samples starting at src_first.
+		// Chroma planes are sampled in their own coordinates, a chroma sample sits
+		// in the middle of the 1 << shift luma samples it covers. Taps are clamped
+		// to the plane (plane_len luma samples), not to the crop window.
+		void taps(std::vector<Tap>& out, int first, int count, int dst_len, int src_first, int src_len, int plane_len, int shift, Filter filter)
+		{
+			out.resize(count);
+			int limit = ((plane_len + (1 << shift) - 1) >> shift) - 1;
+			int64_t scale = ((int64_t)src_len << 16) / dst_len; // luma samples per pixel, 16.16
+
+			for (int i = 0; i < count; ++i)
+			{
+				int64_t center = ((((int64_t)(first + i) << 16) + 0x8000) * scale >> 16) + ((int64_t)src_first << 16); // luma coordinate, 16.16
+				int64_t pos = (center >> shift) - 0x8000;
+				Tap& tap = out[i];
+
+				if (filter == Nearest)
+				{
+					tap.index = (int)((pos + 0x8000) >> 16);
+					tap.weight = 0;
+				}
+				else
+				{
+					if (pos < 0) pos = 0;
+					tap.index = (int)(pos >> 16);
+					tap.weight = (int)(pos >> 8) & 0xFF;
+				}
+
+				if (tap.index >= limit)
+				{
+					tap.index = limit;
+					tap.weight = 0;
+				}
+			}
+		}
+
+		inline int lerp(int a, int b, int weight)
+		{
+			return (a << 8) + (b - a) * weight;
+		}
+
+		// bilinear blend of four samples, weights are 8-bit
+		inline uint8_t sample(const uint8_t* top, const uint8_t* bottom, int step, const Tap& x, int fy)
+		{
+			int a = lerp(top[x.index * step], top[(x.index + (x.weight ? 1 : 0)) * step], x.weight);
+			int b = lerp(bottom[x.index * step], bottom[(x.index + (x.weight ? 1 : 0)) * step], x.weight);
+			return (uint8_t)((lerp(a, b, fy) + 0x8000) >> 16);
+		}
+
+		template <Layout L, typename C>
+		void convert_scaled(const Frame& frame, const Rect& crop, uint32_t* out, int out_stride,
+			int dst_w, int dst_h, int x0, int y0, int w, int h, Filter filter, bool bgra)
+		{
+			typedef Traits<L> T;
+
+			std::vector<Tap> luma_x, chroma_x, luma_y, chroma_y;
+			taps(luma_x, x0, w, dst_w, crop.x, crop.width, frame.width, 0, filter);
+			taps(chroma_x, x0, w, dst_w, crop.x, crop.width, frame.width, T::H_SHIFT, filter);
+			taps(luma_y, y0, h, dst_h, crop.y, crop.height, frame.height, 0, filter);
+			taps(chroma_y, y0, h, dst_h, crop.y, crop.height, frame.height, T::V_SHIFT, filter);
+
+			// one resampled 4:4:4 row, converted by the regular row kernel
+			std::vector<uint8_t> line(w * 3);
+			Rows resampled = { &line[0], &line[w], &line[w * 2] };
+			uint8_t* Y = &line[0];
+			uint8_t* U = &line[w];
+			uint8_t* V = &line[w * 2];
+
+			for (int row = 0; row < h; ++row)
+			{
+				const Tap& ly = luma_y[row];
+				const Tap& cy = chroma_y[row];
+				Rows top = T::rows(frame, ly.index, cy.index);
+				Rows bottom = T::rows(frame, ly.index + (ly.weight ? 1 : 0), cy.index + (cy.weight ? 1 : 0));
+
+				for (int x = 0; x < w; ++x)
+				{
+					Y[x] = sample(top.Y, bottom.Y, T::Y_STEP, luma_x[x], ly.weight);
+					U[x] = sample(top.U, bottom.U, T::C_STEP, chroma_x[x], cy.weight);
+					V[x] = sample(top.V, bottom.V, T::C_STEP, chroma_x[x], cy.weight);
+				}
+
+				convert_row<I444, C>(resampled, out + row * out_stride, w, bgra);
+			}
+		}
+
+		// Calls fn.run<Layout, Coefficients>() for the frame's layout, matrix and
+		// range, so every combination gets its own kernel with constant multipliers.
+		template <typename C, typename Fn>
+		void dispatch_layout(const Frame& frame, Fn& fn)
+		{
+			switch (frame.layout)
+			{
+			case I420: fn.template run<I420, C>(); break;
+			case NV12: fn.template run<NV12, C>(); break;
+			case NV21: fn.template run<NV21, C>(); break;
+			case I422: fn.template run<I422, C>(); break;
+			case I444: fn.template run<I444, C>(); break;
+			case YUY2: fn.template run<YUY2, C>(); break;
+			}
+		}
+
+		template <typename Fn>
+		void dispatch(const Frame& frame, Fn& fn)
+		{
+			bool full = frame.range == Full;
+			switch (frame.matrix)
+			{
+			case BT601:
+				full ? dispatch_layout<Coefficients<BT601, Full> >(frame, fn) : dispatch_layout<Coefficients<BT601, Limited> >(frame, fn);
+				break;
+			case BT709:
+				full ? dispatch_layout<Coefficients<BT709, Full> >(frame, fn) : dispatch_layout<Coefficients<BT709, Limited> >(frame, fn);
+				break;
+			case BT2020:
+				full ? dispatch_layout<Coefficients<BT2020, Full> >(frame, fn) : dispatch_layout<Coefficients<BT2020, Limited> >(frame, fn);
+				break;
+			}
+		}
+
+		struct WholeFrame
+		{
+			const Frame& frame;
+			const Rect& crop;
+			uint8_t* out;
+			int out_stride; // in bytes
+			bool bgra;
+
+			template <Layout L, typename C>
+			void run() { convert_frame<L, C>(frame, crop, out, out_stride, bgra); }
+		};
+
+		struct ScaledFrame
+		{
+			const Frame& frame;
+			const Rect& crop;
+			uint32_t* out;
+			int out_stride;
+			int dst_w, dst_h;
+			int x0, y0, w, h;
+			Filter filter;
+			bool bgra;
+
+			template <Layout L, typename C>
+			void run() { convert_scaled<L, C>(frame, crop, out, out_stride, dst_w, dst_h, x0, y0, w, h, filter, bgra); }
+		};
+
+		// clips the crop window to the frame, false if nothing is left
+		bool clip(const Frame& frame, Rect& crop)
+		{
+			if (crop.x < 0) { crop.width += crop.x; crop.x = 0; }
+			if (crop.y < 0) { crop.height += crop.y; crop.y = 0; }
+			if (crop.x + crop.width > frame.width) crop.width = frame.width - crop.x;
+			if (crop.y + crop.height > frame.height) crop.height = frame.height - crop.y;
+			return crop.width > 0 && crop.height > 0;
+		}
+	}
+
+	Frame Frame::packed(Layout layout, int width, int height, void* buffer)
+	{
+		auto data = (uint8_t*)buffer;
+		if (layout == YUY2)
+			return Frame(layout, width, height, Plane(data, ((width + 1) >> 1) << 2));
+
+		Frame out(layout, width, height, Plane(data, width));
+		auto cw = out.chroma_width();
+		auto ch = out.chroma_height();
+		data += width * height;
+
+		if (layout == NV12 || layout == NV21)
+		{
+			out.planes[1] = Plane(data, cw << 1);
+			return out;
+		}
+
+		out.planes[1] = Plane(data, cw);
+		out.planes[2] = Plane(data + cw * ch, cw);
+		return out;
+	}
+
+	size_t Frame::packed_size(Layout layout, int width, int height)
+	{
+		if (layout == YUY2)
+			return (((width + 1) >> 1) << 2) * height;
+
+		Frame frame(layout, width, height, Plane());
+		return width * height + 2 * frame.chroma_width() * frame.chroma_height();
+	}
+
+	void convert(const Frame& frame, uint32_t* out, int out_stride)
+	{
+		convert(frame, Rect(0, 0, frame.width, frame.height), out, out_stride);
+	}
+
+	void convert(const Frame& frame, Rect crop, uint32_t* out, int out_stride)
+	{
+		// out receives the clipped window, and the default stride is its width
+		if (!clip(frame, crop))
+			return;
+
+		convert(frame, crop, (void*)out, (out_stride ? out_stride : crop.width) * sizeof(uint32_t));
+	}
+
+	void convert(const Frame& frame, Rect crop, void* out, int out_stride_bytes)
+	{
+		if (!clip(frame, crop))
+			return;
+
+		bool bgra = pp::ImageData::GetNativeImageDataFormat() == PP_IMAGEDATAFORMAT_BGRA_PREMUL;
+
+		WholeFrame job = { frame, crop, (uint8_t*)out, out_stride_bytes, bgra };
+		dispatch(frame, job);
+	}
+
+	void convert(const Frame& frame, Canvas* canvas, int x, int y)
+	{
+		Rect crop(0, 0, frame.width, frame.height);
+
+		// move the crop window instead of writing outside the canvas
+		if (x < 0) { crop.x = -x; crop.width += x; x = 0; }
+		if (y < 0) { crop.y = -y; crop.height += y; y = 0; }
+		if (x + crop.width > canvas->width()) crop.width = canvas->width() - x;
+		if (y + crop.height > canvas->height()) crop.height = canvas->height() - y;
+		if (crop.width <= 0 || crop.height <= 0)
+			return;
+
+		convert(frame, crop, canvas->data() + x + y * canvas->stride(), canvas->stride());
+	}
+
+	void convert(const Frame& frame, pp::ImageData& image, int x, int y)
+	{
+		if (image.format() != pp::ImageData::GetNativeImageDataFormat())
+			return;
+
+		Canvas canvas((uint32_t*)image.data(), image.size().width(), image.size().height(), image.stride() / sizeof(uint32_t));
+		convert(frame, &canvas, x, y);
+	}
+
+	void convert(const Frame& frame, Canvas* canvas, int x, int y, int w, int h, Filter filter)
+	{
+		convert(frame, Rect(0, 0, frame.width, frame.height), canvas, x, y, w, h, filter);
+	}
+
+	void convert(const Frame& frame, Rect crop, Canvas* canvas, int x, int y, int w, int h, Filter filter)
+	{
+		if (w <= 0 || h <= 0 || !clip(frame, crop))
+			return;
+
+		// visible part of the destination rectangle
+		int left = x < 0 ? -x : 0;
+		int top = y < 0 ? -y : 0;
+		int right = x + w > canvas->width() ? canvas->width() - x : w;
+		int bottom = y + h > canvas->height() ? canvas->height() - y : h;
+		if (left >= right || top >= bottom)
+			return;
+
+		uint32_t* out = canvas->data() + (x + left) + (y + top) * canvas->stride();
+		bool bgra = pp::ImageData::GetNativeImageDataFormat() == PP_IMAGEDATAFORMAT_BGRA_PREMUL;
+
+		ScaledFrame job = { frame, crop, out, canvas->stride(), w, h, left, top, right - left, bottom - top, filter, bgra };
+		dispatch(frame, job);
+	}
+}} // gfx::yuv
@@ -0,0 +1,233 @@
+#include <shaker/gfx/yuv.hpp>
+#include <shaker/gfx/basic.hpp>
+#include <shaker/gfx/bitmap.hpp>
+#include <shaker/gfx/canvas.hpp>
+#include "bands.hpp"
+#include "simd.hpp"
+
+namespace gfx { namespace yuv
+{
+	namespace
+	{
+		struct RGB
+		{
+			int r, g, b;
+		};
+
+		inline RGB rgb(uint32_t pixel, bool bgra)
+		{
+			int first = pixel & 0xFF;
+			int second = (pixel >> 8) & 0xFF;
+			int third = (pixel >> 16) & 0xFF;
+			RGB out = { bgra ? third : first, second, bgra ? first : third };
+			return out;
+		}
+
+		template <typename E>
+		inline uint8_t luma(const RGB& c)
+		{
+			return clamp(E::Y_OFFSET + ((E::R_TO_Y * c.r + E::G_TO_Y * c.g + E::B_TO_Y * c.b + 128) >> 8));
+		}
+
+		// c holds the sum of four pixels
+		template <typename E>
+		inline void chroma(RGB c, uint8_t& u, uint8_t& v)
+		{
+			c.r = (c.r + 2) >> 2;
+			c.g = (c.g + 2) >> 2;
+			c.b = (c.b + 2) >> 2;
+			u = clamp(128 + ((E::R_TO_U * c.r + E::G_TO_U * c.g + E::B_TO_U * c.b + 128) >> 8));
+			v = clamp(128 + ((E::R_TO_V * c.r + E::G_TO_V * c.g + E::B_TO_V * c.b + 128) >> 8));
+		}
+
+#if GFX_SSE2
+		// 8 native-order pixels to 16-bit r, g, b
+		inline void load8(const uint32_t* src, bool bgra, __m128i& r, __m128i& g, __m128i& b)
+		{
+			__m128i lo = simd::load16(src);
+			__m128i hi = simd::load16(src + 4);
+			__m128i mask = _mm_set1_epi32(0xFF);
+
+			__m128i first = _mm_packs_epi32(_mm_and_si128(lo, mask), _mm_and_si128(hi, mask));
+			g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(lo, 8), mask), _mm_and_si128(_mm_srli_epi32(hi, 8), mask));
+			__m128i third = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(lo, 16), mask), _mm_and_si128(_mm_srli_epi32(hi, 16), mask));
+
+			r = bgra ? third : first;
+			b = bgra ? first : third;
+		}
+
+		// (kr * r + kg * g + kb * b + 128) >> 8 + offset for 8 lanes, as bytes in the low half
+		inline __m128i dot8(__m128i r, __m128i g, __m128i b, int kr, int kg, int kb, int offset)
+		{
+			__m128i k_rg = simd::pair16(kr, kg);
+			__m128i k_b1 = simd::pair16(kb, 128);
+			__m128i one = _mm_set1_epi16(1);
+
+			__m128i b1_lo = _mm_unpacklo_epi16(b, one), b1_hi = _mm_unpackhi_epi16(b, one);
+			__m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(r, g), k_rg), _mm_madd_epi16(b1_lo, k_b1));
+			__m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(r, g), k_rg), _mm_madd_epi16(b1_hi, k_b1));
+
+			__m128i out = _mm_packs_epi32(_mm_srai_epi32(lo, 8), _mm_srai_epi32(hi, 8));
+			out = _mm_add_epi16(out, _mm_set1_epi16((short)offset));
+			return _mm_packus_epi16(out, out);
+		}
+
+		// sums horizontal pairs of two rows and averages them: 8 lanes -> 4 lanes (repeated)
+		inline __m128i average2x2(__m128i top, __m128i bottom)
+		{
+			__m128i sum = _mm_madd_epi16(_mm_add_epi16(top, bottom), _mm_set1_epi16(1));
+			sum = _mm_srai_epi32(_mm_add_epi32(sum, _mm_set1_epi32(2)), 2);
+			return _mm_packs_epi32(sum, sum);
+		}
+#endif
+
+		template <typename E>
+		void luma_row(const uint32_t* src, int width, uint8_t* Y, bool bgra)
+		{
+			int x = 0;
+#if GFX_SSE2
+			for (; x + 8 <= width; x += 8)
+			{
+				__m128i r, g, b;
+				load8(src + x, bgra, r, g, b);
+				_mm_storel_epi64((__m128i*)(Y + x), dot8(r, g, b, E::R_TO_Y, E::G_TO_Y, E::B_TO_Y, E::Y_OFFSET));
+			}
+#endif
+			for (; x < width; ++x)
+				Y[x] = luma<E>(rgb(src[x], bgra));
+		}
+
+		// U and V are written at U[i * step], V[i * step]
+		template <typename E>
+		void chroma_row(const uint32_t* top, const uint32_t* bottom, int width, uint8_t* U, uint8_t* V, int step, bool bgra)
+		{
+			int x = 0;
+#if GFX_SSE2
+			for (; x + 8 <= width; x += 8)
+			{
+				__m128i r0, g0, b0, r1, g1, b1;
+				load8(top + x, bgra, r0, g0, b0);
+				load8(bottom + x, bgra, r1, g1, b1);
+
+				__m128i r = average2x2(r0, r1);
+				__m128i g = average2x2(g0, g1);
+				__m128i b = average2x2(b0, b1);
+
+				__m128i u = dot8(r, g, b, E::R_TO_U, E::G_TO_U, E::B_TO_U, 128);
+				__m128i v = dot8(r, g, b, E::R_TO_V, E::G_TO_V, E::B_TO_V, 128);
+
+				uint8_t* cu = U + (x >> 1) * step;
+				uint8_t* cv = V + (x >> 1) * step;
+				if (step == 2 && cv == cu + 1)
+				{
+					_mm_storel_epi64((__m128i*)cu, _mm_unpacklo_epi8(u, v));
+				}
+				else
+				{
+					uint32_t lanes[2] = { (uint32_t)_mm_cvtsi128_si32(u), (uint32_t)_mm_cvtsi128_si32(v) };
+					for (int i = 0; i < 4; ++i)
+					{
+						cu[i * step] = (uint8_t)(lanes[0] >> (i * 8));
+						cv[i * step] = (uint8_t)(lanes[1] >> (i * 8));
+					}
+				}
+			}
+#endif
+			// an odd last column counts its pixels twice, which averages what is there
+			for (; x < width; x += 2)
+			{
+				int next = x + 1 < width ? x + 1 : x;
+				RGB a = rgb(top[x], bgra), b = rgb(top[next], bgra);
+				RGB c = rgb(bottom[x], bgra), d = rgb(bottom[next], bgra);
+				RGB sum = { a.r + b.r + c.r + d.r, a.g + b.g + c.g + d.g, a.b + b.b + c.b + d.b };
+				chroma<E>(sum, U[(x >> 1) * step], V[(x >> 1) * step]);
+			}
+		}
+
+		// converts chroma rows [begin, end), with the luma rows they cover
+		template <typename E>
+		void encode_rows(const uint32_t* pixels, int stride, const Frame& frame, int begin, int end, bool bgra)
+		{
+			bool nv12 = frame.layout == NV12;
+			const Plane& Y = frame.planes[0];
+			const Plane& C = frame.planes[1];
+			uint8_t* U = C.data;
+			uint8_t* V = nv12 ? C.data + 1 : frame.planes[2].data;
+			int u_stride = C.stride;
+			int v_stride = nv12 ? C.stride : frame.planes[2].stride;
+			int step = nv12 ? 2 : 1;
+
+			for (int crow = begin; crow < end; ++crow)
+			{
+				int row0 = crow << 1;
+				int row1 = row0 + 1 < frame.height ? row0 + 1 : row0;
+				const uint32_t* top = pixels + row0 * stride;
+				const uint32_t* bottom = pixels + row1 * stride;
+
+				luma_row<E>(top, frame.width, Y.data + row0 * Y.stride, bgra);
+				if (row1 != row0)
+					luma_row<E>(bottom, frame.width, Y.data + row1 * Y.stride, bgra);
+
+				chroma_row<E>(top, bottom, frame.width, U + crow * u_stride, V + crow * v_stride, step, bgra);
+			}
+		}
+
+		template <typename E>
+		void encode_bands(const uint32_t* pixels, int stride, const Frame& frame, int threads)
+		{
+			bool bgra = pp::ImageData::GetNativeImageDataFormat() == PP_IMAGEDATAFORMAT_BGRA_PREMUL;
+			bands(frame.chroma_height(), threads, [=, &frame](int begin, int end)
+			{
+				encode_rows<E>(pixels, stride, frame, begin, end, bgra);
+			});
+		}
+	}
+
+	void encode(const uint32_t* pixels, int stride, const Frame& frame, int threads)
+	{
+		if (frame.layout != I420 && frame.layout != NV12)
+			return;
+
+		if (frame.width <= 0 || frame.height <= 0)
+			return;
+
+		bool full = frame.range == Full;
+		switch (frame.matrix)
+		{
+		case BT601:
+			full ? encode_bands<EncodeCoefficients<BT601, Full> >(pixels, stride, frame, threads)
+				: encode_bands<EncodeCoefficients<BT601, Limited> >(pixels, stride, frame, threads);
+			break;
+		case BT709:
+			full ? encode_bands<EncodeCoefficients<BT709, Full> >(pixels, stride, frame, threads)
+				: encode_bands<EncodeCoefficients<BT709, Limited> >(pixels, stride, frame, threads);
+			break;
+		case BT2020:
+			full ? encode_bands<EncodeCoefficients<BT2020, Full> >(pixels, stride, frame, threads)
+				: encode_bands<EncodeCoefficients<BT2020, Limited> >(pixels, stride, frame, threads);
+			break;
+		}
+	}
+
+	namespace
+	{
+		// the part of the frame covered by a w x h source
+		Frame clipped(const Frame& frame, int w, int h)
+		{
+			Frame out = frame;
+			if (out.width > w) out.width = w;
+			if (out.height > h) out.height = h;
+			return out;
+		}
+	}
+
+	void encode(const Bitmap& bmp, const Frame& frame, int threads)
+	{
+		encode(bmp.data(), bmp.stride(), clipped(frame, bmp.width(), bmp.height()), threads);
+	}
+
+	void encode(const Canvas& canvas, const Frame& frame, int threads)
+	{
+		encode(canvas.data(), canvas.stride(), clipped(frame, canvas.width(), canvas.height()), threads);
+	}
+}} // gfx::yuv
@@ -0,0 +1,199 @@
+#include <shaker/gfx/yuv_incremental.hpp>
+#include "simd.hpp"
+#include <string.h>
+
+namespace gfx { namespace yuv
+{
+	namespace
+	{
+		bool same(const uint8_t* a, const uint8_t* b, int length)
+		{
+			int i = 0;
+#if GFX_SSE2
+			for (; i + 16 <= length; i += 16)
+			{
+				__m128i eq = _mm_cmpeq_epi8(simd::load16(a + i), simd::load16(b + i));
+				if (_mm_movemask_epi8(eq) != 0xFFFF)
+					return false;
+			}
+#endif
+			for (; i < length; ++i)
+			{
+				if (a[i] != b[i])
+					return false;
+			}
+			return true;
+		}
+
+		// byte range [begin, end) of luma columns [x0, x1) in a plane
+		inline void columns(int x0, int x1, int h_shift, int bpp, int& begin, int& end)
+		{
+			begin = (x0 >> h_shift) * bpp;
+			end = ((x1 + (1 << h_shift) - 1) >> h_shift) * bpp;
+		}
+
+		inline void rows(int y0, int y1, int v_shift, int& begin, int& end)
+		{
+			begin = y0 >> v_shift;
+			end = (y1 + (1 << v_shift) - 1) >> v_shift;
+		}
+	}
+
+	Incremental::Incremental()
+		: m_layout(I420)
+		, m_matrix(BT601)
+		, m_range(Limited)
+		, m_width(0)
+		, m_height(0)
+		, m_valid(false)
+		, m_plane_count(0)
+	{
+	}
+
+	void Incremental::reset()
+	{
+		m_valid = false;
+	}
+
+	bool Incremental::matches(const Frame& frame) const
+	{
+		return m_valid && m_layout == frame.layout && m_width == frame.width && m_height == frame.height
+			&& m_matrix == frame.matrix && m_range == frame.range;
+	}
+
+	// allocates the plane copies for the frame's geometry and fills them
+	void Incremental::remember(const Frame& frame)
+	{
+		m_layout = frame.layout;
+		m_matrix = frame.matrix;
+		m_range = frame.range;
+		m_width = frame.width;
+		m_height = frame.height;
+
+		int hs = Frame::chroma_shift_x(frame.layout);
+		int vs = Frame::chroma_shift_y(frame.layout);
+
+		switch (frame.layout)
+		{
+		case YUY2:
+			m_plane_count = 1;
+			m_planes[0].h_shift = 1; m_planes[0].v_shift = 0; m_planes[0].bpp = 4;
+			break;
+		case NV12:
+		case NV21:
+			m_plane_count = 2;
+			m_planes[0].h_shift = 0; m_planes[0].v_shift = 0; m_planes[0].bpp = 1;
+			m_planes[1].h_shift = hs; m_planes[1].v_shift = vs; m_planes[1].bpp = 2;
+			break;
+		default:
+			m_plane_count = 3;
+			m_planes[0].h_shift = 0; m_planes[0].v_shift = 0; m_planes[0].bpp = 1;
+			for (int i = 1; i < 3; ++i)
+			{
+				m_planes[i].h_shift = hs;
+				m_planes[i].v_shift = vs;
+				m_planes[i].bpp = 1;
+			}
+			break;
+		}
+
+		for (int i = 0; i < m_plane_count; ++i)
+		{
+			auto& plane = m_planes[i];
+			int begin, end, first, last;
+			columns(0, m_width, plane.h_shift, plane.bpp, begin, end);
+			rows(0, m_height, plane.v_shift, first, last);
+			plane.stride = end;
+			plane.pixels.resize(plane.stride * last);
+		}
+
+		copy(frame, Rect(0, 0, m_width, m_height));
+		m_valid = true;
+	}
+
+	bool Incremental::changed(const Frame& frame, const Rect& block) const
+	{
+		for (int i = 0; i < m_plane_count; ++i)
+		{
+			auto& plane = m_planes[i];
+			int begin, end, first, last;
+			columns(block.x, block.x + block.width, plane.h_shift, plane.bpp, begin, end);
+			rows(block.y, block.y + block.height, plane.v_shift, first, last);
+
+			for (int row = first; row < last; ++row)
+			{
+				const uint8_t* current = frame.planes[i].data + row * frame.planes[i].stride + begin;
+				const uint8_t* previous = plane.pixels.data() + row * plane.stride + begin;
+				if (!same(current, previous, end - begin))
+					return true;
+			}
+		}
+		return false;
+	}
+
+	void Incremental::copy(const Frame& frame, const Rect& rect)
+	{
+		for (int i = 0; i < m_plane_count; ++i)
+		{
+			auto& plane = m_planes[i];
+			int begin, end, first, last;
+			columns(rect.x, rect.x + rect.width, plane.h_shift, plane.bpp, begin, end);
+			rows(rect.y, rect.y + rect.height, plane.v_shift, first, last);
+
+			for (int row = first; row < last; ++row)
+			{
+				memcpy(plane.pixels.data() + row * plane.stride + begin,
+					frame.planes[i].data + row * frame.planes[i].stride + begin,
+					end - begin);
+			}
+		}
+	}
+
+	const std::vector<Rect>& Incremental::update(const Frame& frame, uint32_t* out, int out_stride)
+	{
+		if (!out_stride)
+			out_stride = frame.width;
+
+		m_damage.clear();
+
+		if (!matches(frame))
+		{
+			convert(frame, out, out_stride);
+			remember(frame);
+			m_damage.push_back(Rect(0, 0, frame.width, frame.height));
+			return m_damage;
+		}
+
+		for (int y = 0; y < m_height; y += BLOCK)
+		{
+			int h = m_height - y < BLOCK ? m_height - y : BLOCK;
+			int run = -1; // first column of the current run of changed blocks
+			int blocks = (m_width + BLOCK - 1) / BLOCK;
+
+			// one step past the last block, to flush a run reaching the right edge
+			for (int block = 0; block <= blocks; ++block)
+			{
+				int x = block * BLOCK;
+				bool dirty = block < blocks && changed(frame, Rect(x, y, m_width - x < BLOCK ? m_width - x : BLOCK, h));
+				if (dirty)
+				{
+					if (run < 0)
+						run = x;
+					continue;
+				}
+
+				if (run < 0)
+					continue;
+
+				int end = x < m_width ? x : m_width;
+				Rect rect(run, y, end - run, h);
+				convert(frame, rect, out + rect.x + rect.y * out_stride, out_stride);
+				copy(frame, rect);
+				m_damage.push_back(rect);
+				run = -1;
+			}
+		}
+
+		return m_damage;
+	}
+}} // gfx::yuv
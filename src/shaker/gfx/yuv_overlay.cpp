@@ -0,0 +1,160 @@
+#include <shaker/gfx/yuv_overlay.hpp>
+#include <shaker/gfx/basic.hpp>
+
+namespace gfx { namespace yuv
+{
+	namespace
+	{
+		template <typename E>
+		Color encode(uint32_t argb)
+		{
+			int r = (argb >> 16) & 0xFF;
+			int g = (argb >> 8) & 0xFF;
+			int b = argb & 0xFF;
+
+			Color out = {
+				clamp(E::Y_OFFSET + ((E::R_TO_Y * r + E::G_TO_Y * g + E::B_TO_Y * b + 128) >> 8)),
+				clamp(128 + ((E::R_TO_U * r + E::G_TO_U * g + E::B_TO_U * b + 128) >> 8)),
+				clamp(128 + ((E::R_TO_V * r + E::G_TO_V * g + E::B_TO_V * b + 128) >> 8)),
+				(uint8_t)(argb >> 24)
+			};
+			return out;
+		}
+
+		// where a layout keeps its samples
+		struct Geometry
+		{
+			int h_shift, v_shift;
+			int y_step, c_step;
+			int c_plane, u_offset, v_offset;
+
+			explicit Geometry(Layout layout)
+				: h_shift(Frame::chroma_shift_x(layout))
+				, v_shift(Frame::chroma_shift_y(layout))
+				, y_step(1)
+				, c_step(1)
+				, c_plane(1)
+				, u_offset(0)
+				, v_offset(0)
+			{
+				switch (layout)
+				{
+				case NV12: c_step = 2; v_offset = 1; break;
+				case NV21: c_step = 2; u_offset = 1; break;
+				case YUY2: y_step = 2; c_step = 4; c_plane = 0; u_offset = 1; v_offset = 3; break;
+				default: break;
+				}
+			}
+
+			uint8_t* luma(const Frame& f, int x, int y) const
+			{
+				return f.planes[0].data + y * f.planes[0].stride + x * y_step;
+			}
+
+			uint8_t* u(const Frame& f, int cx, int cy) const
+			{
+				return f.planes[c_plane].data + cy * f.planes[c_plane].stride + cx * c_step + u_offset;
+			}
+
+			uint8_t* v(const Frame& f, int cx, int cy) const
+			{
+				if (c_plane == 1 && c_step == 1)
+					return f.planes[2].data + cy * f.planes[2].stride + cx;
+				return f.planes[c_plane].data + cy * f.planes[c_plane].stride + cx * c_step + v_offset;
+			}
+		};
+
+		// Blends color into the part of the frame inside bounds (already clipped),
+		// with coverage(x, y) giving the 8-bit coverage of a luma pixel.
+		template <typename Coverage>
+		void composite(const Frame& frame, const Rect& bounds, Coverage coverage, const Color& color)
+		{
+			Geometry g(frame.layout);
+
+			for (int y = bounds.y; y < bounds.y + bounds.height; ++y)
+			{
+				for (int x = bounds.x; x < bounds.x + bounds.width; ++x)
+				{
+					int a = coverage(x, y);
+					if (!a)
+						continue;
+					uint8_t* Y = g.luma(frame, x, y);
+					*Y = a == 255 ? color.y : gfx::blend(a, color.y, *Y);
+				}
+			}
+
+			int cx0 = bounds.x >> g.h_shift, cx1 = (bounds.x + bounds.width - 1) >> g.h_shift;
+			int cy0 = bounds.y >> g.v_shift, cy1 = (bounds.y + bounds.height - 1) >> g.v_shift;
+
+			for (int cy = cy0; cy <= cy1; ++cy)
+			{
+				for (int cx = cx0; cx <= cx1; ++cx)
+				{
+					int sum = 0, count = 0;
+					for (int y = cy << g.v_shift; y < (cy + 1) << g.v_shift && y < frame.height; ++y)
+					{
+						for (int x = cx << g.h_shift; x < (cx + 1) << g.h_shift && x < frame.width; ++x)
+						{
+							++count;
+							if (x >= bounds.x && x < bounds.x + bounds.width && y >= bounds.y && y < bounds.y + bounds.height)
+								sum += coverage(x, y);
+						}
+					}
+
+					int a = (sum + count / 2) / count;
+					if (!a)
+						continue;
+
+					uint8_t* U = g.u(frame, cx, cy);
+					uint8_t* V = g.v(frame, cx, cy);
+					*U = a == 255 ? color.u : gfx::blend(a, color.u, *U);
+					*V = a == 255 ? color.v : gfx::blend(a, color.v, *V);
+				}
+			}
+		}
+
+		bool clip(const Frame& frame, Rect& rect)
+		{
+			if (rect.x < 0) { rect.width += rect.x; rect.x = 0; }
+			if (rect.y < 0) { rect.height += rect.y; rect.y = 0; }
+			if (rect.x + rect.width > frame.width) rect.width = frame.width - rect.x;
+			if (rect.y + rect.height > frame.height) rect.height = frame.height - rect.y;
+			return rect.width > 0 && rect.height > 0;
+		}
+	}
+
+	Color color(uint32_t argb, Matrix matrix, Range range)
+	{
+		bool full = range == Full;
+		switch (matrix)
+		{
+		case BT709: return full ? encode<EncodeCoefficients<BT709, Full> >(argb) : encode<EncodeCoefficients<BT709, Limited> >(argb);
+		case BT2020: return full ? encode<EncodeCoefficients<BT2020, Full> >(argb) : encode<EncodeCoefficients<BT2020, Limited> >(argb);
+		default: return full ? encode<EncodeCoefficients<BT601, Full> >(argb) : encode<EncodeCoefficients<BT601, Limited> >(argb);
+		}
+	}
+
+	void fill(const Frame& frame, const Rect& rect, const Color& color)
+	{
+		Rect bounds = rect;
+		if (!color.a || !clip(frame, bounds))
+			return;
+
+		int alpha = color.a;
+		composite(frame, bounds, [alpha](int, int){ return alpha; }, color);
+	}
+
+	void blend(const Frame& frame, int x, int y, const uint8_t* mask, int width, int height, int stride, const Color& color)
+	{
+		Rect bounds(x, y, width, height);
+		if (!color.a || !clip(frame, bounds))
+			return;
+
+		int alpha = color.a;
+		composite(frame, bounds, [=](int px, int py) -> int
+		{
+			int a = mask[(py - y) * stride + (px - x)];
+			return alpha == 255 ? a : a * alpha / 255;
+		}, color);
+	}
+}} // gfx::yuv